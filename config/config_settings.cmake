@@ -4,7 +4,9 @@ set(SETTING_MAX_BUTTONS "MaxButtons")
 set(SETTING_VSYNC "VSync")
 set(SETTING_FPS_LIMIT "FPSLimit")
 set(SETTING_APPLICATION_TIMEOUT "ApplicationTimeout")
+set(SETTING_TEXTURE_MEMORY_LIMIT "TextureMemoryLimit")
 set(SETTING_WRAP_ENTRIES "WrapEntries")
+set(SETTING_ANIMATED_NAVIGATION "AnimatedNavigation")
 set(SETTING_BACKGROUND_MODE "Mode")
 set(SETTING_BACKGROUND_COLOR "Color")
 set(SETTING_BACKGROUND_IMAGE "Image")
@@ -36,6 +38,7 @@ set(SETTING_HIGHLIGHT_CORNER_RADIUS "CornerRadius")
 set(SETTING_HIGHLIGHT_VPADDING "VPadding")
 set(SETTING_HIGHLIGHT_HPADDING "HPadding")
 set(SETTING_VCENTER "VCenter")
+set(SETTING_ROWS "Rows")
 set(SETTING_SCROLL_INDICATORS "Enabled")
 set(SETTING_SCROLL_INDICATOR_FILL_COLOR "FillColor")
 set(SETTING_SCROLL_INDICATOR_OUTLINE_SIZE "OutlineSize")
@@ -47,6 +50,8 @@ set(SETTING_MOUSE_SELECT "MouseSelect")
 set(SETTING_INHIBIT_OS_SCREENSAVER "InhibitOSScreensaver")
 set(SETTING_STARTUP_CMD "StartupCmd")
 set(SETTING_QUIT_CMD "QuitCmd")
+set(SETTING_CONTROL_SOCKET "ControlSocket")
+set(SETTING_METRICS_FILE "MetricsFile")
 set(SETTING_CLOCK_ENABLED "Enabled")
 set(SETTING_CLOCK_SHOW_DATE "ShowDate")
 set(SETTING_CLOCK_ALIGNMENT "Alignment")
@@ -98,7 +103,9 @@ set(DEFAULT_MENU "Main")
 set(DEFAULT_MAX_BUTTONS 4)
 set(DEFAULT_VSYNC "true")
 set(DEFAULT_APPLICATION_TIMEOUT "7")
+set(DEFAULT_TEXTURE_MEMORY_LIMIT "0")
 set(DEFAULT_WRAP_ENTRIES "false")
+set(DEFAULT_ANIMATED_NAVIGATION "false")
 set(DEFAULT_BACKGROUND_MODE "Color")
 set(DEFAULT_BACKGROUND_COLOR_R "00")
 set(DEFAULT_BACKGROUND_COLOR_G "00")
@@ -150,6 +157,7 @@ set(DEFAULT_HIGHLIGHT_CORNER_RADIUS 0)
 set(DEFAULT_HIGHLIGHT_VPADDING 30)
 set(DEFAULT_HIGHLIGHT_HPADDING 30)
 set(DEFAULT_VCENTER "50%")
+set(DEFAULT_ROWS 1)
 set(DEFAULT_SCROLL_INDICATORS "true")
 set(DEFAULT_SCROLL_INDICATOR_FILL_COLOR_R "FF")
 set(DEFAULT_SCROLL_INDICATOR_FILL_COLOR_G "FF")
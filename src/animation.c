@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "animation.h"
+#include "debug.h"
+
+static float ease(Easing easing, float t);
+static Tween *find_tween(float *value);
+
+static Tween tweens[MAX_TWEENS];
+
+// A function to map linear progress between 0 and 1 onto an easing curve
+static float ease(Easing easing, float t)
+{
+    switch (easing) {
+        case EASING_OUT_CUBIC:
+            t = 1.0f - t;
+            return 1.0f - t*t*t;
+
+        case EASING_IN_OUT_CUBIC:
+            if (t < 0.5f)
+                return 4.0f*t*t*t;
+            t = 2.0f - 2.0f*t;
+            return 1.0f - t*t*t / 2.0f;
+
+        default:
+            return t;
+    }
+}
+
+// A function to find the tween animating a value
+static Tween *find_tween(float *value)
+{
+    for (int i = 0; i < MAX_TWEENS; i++) {
+        if (tweens[i].value == value)
+            return tweens + i;
+    }
+    return NULL;
+}
+
+// A function to animate a value from where it is now to an end value.
+// A tween already running on the value is retargeted without calling its
+// completion callback. Returns false if the value was set immediately
+// because the duration is 0 or there is no free slot
+bool start_tween(float *value, float end_value, Uint32 duration, Easing easing, TweenCallback complete, void *data)
+{
+    Tween *tween = find_tween(value);
+    if (tween == NULL)
+        tween = find_tween(NULL);
+    if (tween == NULL || !duration) {
+        if (tween == NULL)
+            log_error("No free tween, skipping animation");
+        else
+            tween->value = NULL;
+        *value = end_value;
+        if (complete != NULL)
+            complete(data);
+        return false;
+    }
+    *tween = (Tween) {
+        .value = value,
+        .start_value = *value,
+        .end_value = end_value,
+        .start_time = SDL_GetTicks(),
+        .duration = duration,
+        .easing = easing,
+        .complete = complete,
+        .data = data
+    };
+    return true;
+}
+
+// A function to stop animating a value, leaving it where it is
+void cancel_tween(float *value)
+{
+    Tween *tween = find_tween(value);
+    if (tween != NULL)
+        tween->value = NULL;
+}
+
+// A function to advance all tweens to the given time, returns true and the
+// deadline of the next frame if any are still running
+bool update_tweens(Uint32 now, Uint32 *deadline)
+{
+    bool running = false;
+    for (int i = 0; i < MAX_TWEENS; i++) {
+        Tween *tween = tweens + i;
+        if (tween->value == NULL)
+            continue;
+        Uint32 elapsed = SDL_TICKS_PASSED(now, tween->start_time) ? now - tween->start_time : 0;
+
+        // Free the slot before the callback, which may start another tween
+        if (SDL_TICKS_PASSED(now, tween->start_time + tween->duration)) {
+            *tween->value = tween->end_value;
+            tween->value = NULL;
+            if (tween->complete != NULL)
+                tween->complete(tween->data);
+            continue;
+        }
+        float t = ease(tween->easing, (float) elapsed / (float) tween->duration);
+        *tween->value = tween->start_value + (tween->end_value - tween->start_value) * t;
+        running = true;
+    }
+
+    // Tweens need a new frame as soon as possible
+    if (running)
+        *deadline = now;
+    return running;
+}
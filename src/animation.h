@@ -0,0 +1,25 @@
+#define MAX_TWEENS 16
+
+typedef enum {
+    EASING_LINEAR,
+    EASING_OUT_CUBIC,
+    EASING_IN_OUT_CUBIC
+} Easing;
+
+typedef void (*TweenCallback)(void *data);
+
+// Interpolation of a float value over a period of time
+typedef struct {
+    float         *value; // NULL when the slot is free
+    float         start_value;
+    float         end_value;
+    Uint32        start_time;
+    Uint32        duration;
+    Easing        easing;
+    TweenCallback complete; // Called on the main thread when the tween finishes
+    void          *data;
+} Tween;
+
+bool start_tween(float *value, float end_value, Uint32 duration, Easing easing, TweenCallback complete, void *data);
+void cancel_tween(float *value);
+bool update_tweens(Uint32 now, Uint32 *deadline);
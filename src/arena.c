@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "util.h"
+#include "arena.h"
+#include "debug.h"
+
+static ArenaBlock *add_arena_block(Arena *arena, size_t size);
+static void grow_string_table(Arena *arena);
+
+// A function to add a block of at least the given size to the front of the arena
+static ArenaBlock *add_arena_block(Arena *arena, size_t size)
+{
+    if (size < ARENA_BLOCK_SIZE)
+        size = ARENA_BLOCK_SIZE;
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (block == NULL)
+        log_fatal("Could not allocate arena block");
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+// A function to allocate aligned memory from the arena
+void *arena_alloc(Arena *arena, size_t size)
+{
+    ArenaBlock *block = arena->blocks;
+    size_t offset = 0;
+    if (block != NULL) {
+        uintptr_t address = (uintptr_t) (block->data + block->used);
+        offset = block->used + ((ARENA_ALIGNMENT - address % ARENA_ALIGNMENT) % ARENA_ALIGNMENT);
+    }
+
+    // Start a new block if the allocation doesn't fit in the current one
+    if (block == NULL || offset + size > block->size) {
+        block = add_arena_block(arena, size + ARENA_ALIGNMENT);
+        uintptr_t address = (uintptr_t) block->data;
+        offset = (ARENA_ALIGNMENT - address % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+    }
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+// A function to copy a string into the arena
+char *arena_strdup(Arena *arena, const char *string)
+{
+    size_t size = strlen(string) + 1;
+    char *copy = arena_alloc(arena, size);
+    memcpy(copy, string, size);
+    return copy;
+}
+
+// A function to calculate the 32-bit FNV-1a hash of a string
+Uint32 hash_string(const char *string)
+{
+    Uint32 hash = 2166136261u;
+    for (const char *p = string; *p != '\0'; p++) {
+        hash ^= (Uint8) *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// A function to double the size of the string table
+static void grow_string_table(Arena *arena)
+{
+    Uint32 capacity = arena->capacity ? 2 * arena->capacity : STRING_TABLE_MIN_SIZE;
+    char **strings = calloc(capacity, sizeof(char*));
+    if (strings == NULL)
+        log_fatal("Could not allocate string table");
+    for (Uint32 i = 0; i < arena->capacity; i++) {
+        if (arena->strings[i] == NULL)
+            continue;
+        Uint32 j = hash_string(arena->strings[i]) & (capacity - 1);
+        while (strings[j] != NULL)
+            j = (j + 1) & (capacity - 1);
+        strings[j] = arena->strings[i];
+    }
+    free(arena->strings);
+    arena->strings = strings;
+    arena->capacity = capacity;
+}
+
+// A function to get a shared copy of a string from the arena, identical
+// strings such as repeated icon paths and commands are stored only once.
+// Interned strings must not be modified
+char *intern_string(Arena *arena, const char *string)
+{
+    if (string == NULL)
+        return NULL;
+
+    // Keep the table at most half full
+    if (2 * (arena->num_strings + 1) > arena->capacity)
+        grow_string_table(arena);
+    Uint32 i = hash_string(string) & (arena->capacity - 1);
+    while (arena->strings[i] != NULL) {
+        if (MATCH(arena->strings[i], string))
+            return arena->strings[i];
+        i = (i + 1) & (arena->capacity - 1);
+    }
+    arena->strings[i] = arena_strdup(arena, string);
+    arena->num_strings++;
+    return arena->strings[i];
+}
+
+// A function to free every allocation in the arena at once, keeping the
+// most recent block for reuse
+void reset_arena(Arena *arena)
+{
+    if (arena->blocks == NULL)
+        return;
+    ArenaBlock *tmp;
+    for (ArenaBlock *block = arena->blocks->next; block != NULL; block = tmp) {
+        tmp = block->next;
+        free(block);
+    }
+    arena->blocks->next = NULL;
+    arena->blocks->used = 0;
+    if (arena->strings != NULL)
+        memset(arena->strings, 0, arena->capacity * sizeof(char*));
+    arena->num_strings = 0;
+}
+
+// A function to release all memory held by the arena
+void free_arena(Arena *arena)
+{
+    ArenaBlock *tmp;
+    for (ArenaBlock *block = arena->blocks; block != NULL; block = tmp) {
+        tmp = block->next;
+        free(block);
+    }
+    free(arena->strings);
+    *arena = (Arena) {0};
+}
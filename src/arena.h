@@ -0,0 +1,26 @@
+#define ARENA_BLOCK_SIZE 65536
+#define ARENA_ALIGNMENT 16
+#define STRING_TABLE_MIN_SIZE 256
+
+// Block of memory that allocations are bumped out of
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t             size;
+    size_t             used;
+    unsigned char      data[];
+} ArenaBlock;
+
+// Bump allocator for data that lives as long as the config, freed all at once
+typedef struct {
+    ArenaBlock *blocks; // Most recent block first
+    char       **strings; // Open addressing hash table of interned strings
+    Uint32     capacity;
+    Uint32     num_strings;
+} Arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strdup(Arena *arena, const char *string);
+char *intern_string(Arena *arena, const char *string);
+Uint32 hash_string(const char *string);
+void reset_arena(Arena *arena);
+void free_arena(Arena *arena);
@@ -5,23 +5,26 @@
 #include <time.h>
 #include <SDL.h>
 #include <SDL_ttf.h>
-#include <SDL_thread.h>
 #include "launcher.h"
 #include <launcher_config.h>
 #include "util.h"
 #include "image.h"
 #include "clock.h"
+#include "text.h"
 #include "debug.h"
+#include "trace.h"
+#include "metrics.h"
 #include "platform/platform.h"
 
 static void calculate_text_metrics(TTF_Font *font, const char *text, int *h, int *x_offset);
 static void calculate_clock_geometry(Clock *clk);
 static void format_time(Clock *clk);
 static void format_date(Clock *clk);
+static void get_format_strings(Clock *clk);
 static void calculate_clock_positioning(Clock *clk);
+static void prerender_clock_glyphs(Clock *clk);
 
 extern Config config;
-extern State state;
 extern Geometry geo;
 
 // A function to calculate height and x offset of text
@@ -91,82 +94,85 @@ static void calculate_clock_geometry(Clock *clk)
 // A function to get the current time from the operating system
 void get_time(Clock *clk)
 {
-    int previous_min = 0;
-    int previous_day = 0;
-    if (clk->time_info != NULL) {
-        previous_min = clk->time_info->tm_min;
-        previous_day = clk->time_info->tm_mday;
-    }
+    struct tm time_info;
 
-    // Get current time
+    // Convert into a local copy so nothing shares the C library's static buffer
     time(&clk->current_time);
-    clk->time_info = localtime(&clk->current_time);
+#ifdef _WIN32
+    bool valid = !localtime_s(&time_info, &clk->current_time);
+#else
+    bool valid = localtime_r(&clk->current_time, &time_info) != NULL;
+#endif
+    if (!valid)
+        return;
     
     // Set render flags if time and/or date changed
-    if (clk->time_info == NULL || previous_min != clk->time_info->tm_min) {
+    if (!clk->time_valid || clk->time_info.tm_min != time_info.tm_min ||
+    clk->time_info.tm_hour != time_info.tm_hour) {
         clk->render_time = true;
-        if (clk->time_info == NULL || previous_day != clk->time_info->tm_mday)
+        if (!clk->time_valid || clk->time_info.tm_mday != time_info.tm_mday)
             clk->render_date = true;
     }
+    clk->time_info = time_info;
+    clk->time_valid = true;
+}
+
+// A function to get the number of milliseconds until the next minute
+// boundary of the wall clock, which is also where the date changes
+Uint32 get_time_to_next_minute()
+{
+    struct timespec now;
+    if (!timespec_get(&now, TIME_UTC))
+        return MS_PER_MINUTE;
+    Uint32 elapsed = (Uint32) (now.tv_sec % 60) * 1000 + (Uint32) (now.tv_nsec / 1000000);
+    return MS_PER_MINUTE - elapsed;
 }
 
 // A function to format the current time according to user settings
 static void format_time(Clock *clk)
 {
-    char *format = NULL;
-    if (clk->time_format == FORMAT_TIME_24HR)
-        format = TIME_STRING_24HR;
-    else
-        format = TIME_STRING_12HR;
     strftime(clk->time_string, 
         sizeof(clk->time_string), 
-        format, 
-        clk->time_info
+        clk->time_format_string, 
+        &clk->time_info
     );
 }
 
 // A function to format the current date according to user settings
 static void format_date(Clock *clk)
 {
-    char *format = NULL;
- 
-    // Get date format
-    if (clk->date_format == FORMAT_DATE_LITTLE)
-        format = DATE_STRING_LITTLE;
-    else
-        format = DATE_STRING_BIG;
-    char weekday[MAX_CLOCK_CHARS + 1];
-    char date[MAX_CLOCK_CHARS + 1];
-    size_t bytes = sizeof(clk->date_string);
+    strftime(clk->date_string, 
+        sizeof(clk->date_string), 
+        clk->date_format_string, 
+        &clk->time_info
+    );
+}
 
-    // Get weekday name
-    if (config.clock_include_weekday) {
-        strftime(weekday, 
-            sizeof(weekday), 
-            "%a ", 
-            clk->time_info
-        );
+// A function to resolve the time and date format strings once at startup
+static void get_format_strings(Clock *clk)
+{
+    // Look up the region only if a format is set to auto
+    if (clk->time_format == FORMAT_TIME_AUTO || clk->date_format == FORMAT_DATE_AUTO) {
+        char region[3];
+        memset(region, '\0', sizeof(region));
+        get_region(region);
+        if (clk->time_format == FORMAT_TIME_AUTO)
+            clk->time_format = get_time_format(region);
+        if (config.clock_show_date && clk->date_format == FORMAT_DATE_AUTO)
+            clk->date_format = get_date_format(region);
     }
-    else
-        weekday[0] = '\0';
-    copy_string(clk->date_string, 
-        weekday, 
-        sizeof(clk->date_string)
+    clk->time_format_string = clk->time_format == FORMAT_TIME_24HR ? TIME_STRING_24HR : TIME_STRING_12HR;
+
+    // Prefix the weekday name to the date
+    const char *date_format = clk->date_format == FORMAT_DATE_LITTLE ? DATE_STRING_LITTLE : DATE_STRING_BIG;
+    copy_string(clk->date_format_string,
+        config.clock_include_weekday ? "%a " : "",
+        sizeof(clk->date_format_string)
+    );
+    strncat(clk->date_format_string,
+        date_format,
+        sizeof(clk->date_format_string) - strlen(clk->date_format_string) - 1
     );
-    bytes -= strlen(weekday);
-    if (bytes) {
-        // Get date
-        strftime(date, 
-            sizeof(date), 
-            format, 
-            clk->time_info
-        );
-        bytes -= strlen(date);
-        strncat(clk->date_string, 
-            date,
-            bytes
-        );
-    }
 }
 
 // A function to calculate the x and y coordinates of the clock text
@@ -201,7 +207,7 @@ void init_clock(Clock *clk)
     };
     clk->time_format = config.clock_time_format;
     clk->date_format = config.clock_date_format;
-    clk->time_info = NULL;
+    clk->time_valid = false;
     if (config.clock_shadows) {
         clk->text_info.shadow_color = &config.clock_shadow_color;
         calculate_shadow_alpha(clk->text_info);
@@ -216,70 +222,99 @@ void init_clock(Clock *clk)
         return;
     }
 
-    // Get time and format it into a string
+    // Get time and format strings
+    get_format_strings(clk);
     get_time(clk);
-    if (clk->time_format == FORMAT_TIME_AUTO || clk->date_format == FORMAT_DATE_AUTO) {
-        char region[3];
-        memset(region, '\0', sizeof(region));
-        get_region(region);
-        if (clk->time_format == FORMAT_TIME_AUTO)
-            clk->time_format = get_time_format(region);
-        if (config.clock_show_date && clk->date_format == FORMAT_DATE_AUTO)
-            clk->date_format = get_date_format(region);
+
+    // Rasterize every glyph the clock can display up front, so later
+    // updates only rebuild the quad lists
+    clk->time_layout = (TextLayout) {0};
+    clk->date_layout = (TextLayout) {0};
+    prerender_clock_glyphs(clk);
+
+    // Lay out the time and date
+    clk->render_date = config.clock_show_date;
+    render_clock(clk);
+}
+
+// A function to rasterize the digits, separators and names used by the clock
+static void prerender_clock_glyphs(Clock *clk)
+{
+    char glyphs[CLOCK_GLYPHS_BUFFER_SIZE] = "0123456789: ";
+    char name[MAX_CLOCK_CHARS + 1];
+    struct tm time_info = {0};
+
+    // AM/PM designators
+    for (int i = 0; i < 2; i++) {
+        time_info.tm_hour = 12*i;
+        strftime(name, sizeof(name), "%p", &time_info);
+        strncat(glyphs, name, sizeof(glyphs) - strlen(glyphs) - 1);
     }
 
-    // Render the time and date
-    format_time(clk);
-    clk->time_texture = render_text_texture(clk->time_string,
-                            &clk->text_info,
-                            &clk->time_rect,
-                            NULL
-                        );
+    // Weekday and month names
     if (config.clock_show_date) {
-        format_date(clk);
-        clk->date_texture = render_text_texture(clk->date_string,
-                                &clk->text_info,
-                                &clk->date_rect,
-                                NULL
-                            );
+        for (int i = 0; i < 7; i++) {
+            time_info.tm_wday = i;
+            strftime(name, sizeof(name), "%a", &time_info);
+            strncat(glyphs, name, sizeof(glyphs) - strlen(glyphs) - 1);
+        }
+        for (int i = 0; i < 12; i++) {
+            time_info.tm_mon = i;
+            strftime(name, sizeof(name), "%b", &time_info);
+            strncat(glyphs, name, sizeof(glyphs) - strlen(glyphs) - 1);
+        }
     }
 
-    // Calculate geometry
-    calculate_clock_geometry(clk);
-    calculate_clock_positioning(clk);
-    clk->render_time = false;
-    clk->render_date = false;
+    // Laying out the full glyph set also reserves enough quads in both
+    // layouts for any time or date string
+    SDL_Rect rect;
+    layout_text(glyphs, &clk->text_info, &clk->time_layout, &rect, NULL);
+    if (config.clock_show_date)
+        layout_text(glyphs, &clk->text_info, &clk->date_layout, &rect, NULL);
 }
 
-// A function to render the time to image
+// A function to format and lay out the time and date from the glyph atlas
 void render_clock(Clock *clk)
 {
+    TRACE_BEGIN(render_clock);
     format_time(clk);
-    clk->time_surface = render_text(clk->time_string,
-                            &clk->text_info,
-                            &clk->time_rect,
-                            NULL
-                        );
+    layout_text(clk->time_string,
+        &clk->text_info,
+        &clk->time_layout,
+        &clk->time_rect,
+        NULL
+    );
     if (clk->render_date) {
         format_date(clk);
-        clk->date_surface = render_text(clk->date_string,
-                                &clk->text_info,
-                                &clk->date_rect,
-                                NULL
-                            );
-        calculate_clock_geometry(clk);
+        layout_text(clk->date_string,
+            &clk->text_info,
+            &clk->date_layout,
+            &clk->date_rect,
+            NULL
+        );
     }
+    calculate_clock_geometry(clk);
     calculate_clock_positioning(clk);
-    state.clock_ready = true;
+    clk->render_time = false;
+    clk->render_date = false;
+    ADD_COUNTER(clock_renders, 1);
+    TRACE_END(render_clock);
 }
 
-// A functio nto render the time to image in a separate thread
-int render_clock_async(void *data)
+// A function to draw the clock to the screen
+void draw_clock(Clock *clk)
 {
-    Clock *clk = (Clock*) data;
-    render_clock(clk);
-    return 0;
-} 
+    draw_text(&clk->time_layout, &clk->text_info, &clk->time_rect);
+    if (config.clock_show_date)
+        draw_text(&clk->date_layout, &clk->text_info, &clk->date_rect);
+}
+
+// A function to free the clock layouts
+void quit_clock(Clock *clk)
+{
+    free_text_layout(&clk->time_layout);
+    free_text_layout(&clk->date_layout);
+}
 
 // A function to get the time format for a region
 TimeFormat get_time_format(const char *region)
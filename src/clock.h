@@ -1,23 +1,27 @@
 #define MAX_CLOCK_CHARS 20
+#define MAX_CLOCK_FORMAT_CHARS 16
 #define CLOCK_SPACING_FACTOR 0.5F
+#define CLOCK_GLYPHS_BUFFER_SIZE 512
+#define MS_PER_MINUTE 60000
 
 // Clock
 typedef struct {
-    SDL_Surface *time_surface;
-    SDL_Surface *date_surface;
-    SDL_Texture *time_texture;
-    SDL_Texture *date_texture;
+    TextLayout time_layout;
+    TextLayout date_layout;
     SDL_Rect time_rect;
     SDL_Rect date_rect;
     TextInfo text_info;
     time_t current_time;
-    struct tm *time_info;
+    struct tm time_info;
+    bool time_valid;
     int x_offset_time;
     int x_offset_date;
     int y_offset;
     int y_advance;
     char time_string[MAX_CLOCK_CHARS + 1];
     char date_string[MAX_CLOCK_CHARS + 1];
+    const char *time_format_string;
+    char date_format_string[MAX_CLOCK_FORMAT_CHARS + 1];
     TimeFormat time_format;
     DateFormat date_format;
     bool render_time;
@@ -26,7 +30,9 @@ typedef struct {
 
 void init_clock(Clock *clk);
 void get_time(Clock *clk);
+Uint32 get_time_to_next_minute(void);
 void render_clock(Clock *clk);
-int render_clock_async(void *data);
+void draw_clock(Clock *clk);
+void quit_clock(Clock *clk);
 TimeFormat get_time_format(const char *region);
 DateFormat get_date_format(const char *region);
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "util.h"
+#include "control.h"
+#include "debug.h"
+#include "trace.h"
+
+static int control_thread(void *data);
+static void serve_client(int fd);
+static bool run_batch(int fd, ControlBatch *batch);
+static bool write_all(int fd, const char *buffer, size_t length);
+
+static ControlServer server = {.listen_fd = -1, .client_fd = -1};
+static ControlBatch batch;
+
+// A function to open the control socket and start accepting clients
+int init_control(const char *path)
+{
+    struct sockaddr_un address = {0};
+    struct stat st;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        log_error("Control socket path '%s' is too long", path);
+        return 1;
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    // Remove a socket left behind by a previous instance, but never a regular file
+    if (!lstat(path, &st)) {
+        if (!S_ISSOCK(st.st_mode)) {
+            log_error("Control socket path '%s' exists and is not a socket", path);
+            return 1;
+        }
+        unlink(path);
+    }
+
+    server.event_type = SDL_RegisterEvents(1);
+    if (server.event_type == (Uint32) -1) {
+        log_error("Could not register control event\n%s", SDL_GetError());
+        return 1;
+    }
+    server.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server.listen_fd < 0) {
+        log_error("Could not create control socket\n%s", strerror(errno));
+        return 1;
+    }
+
+    // Create the socket accessible to the user only, so nobody else can
+    // connect before its permissions are set
+    mode_t mask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
+    int error = bind(server.listen_fd, (struct sockaddr*) &address, sizeof(address));
+    umask(mask);
+    if (error || listen(server.listen_fd, CONTROL_BACKLOG)) {
+        log_error("Could not listen on control socket '%s'\n%s", path, strerror(errno));
+        close(server.listen_fd);
+        server.listen_fd = -1;
+        return 1;
+    }
+    server.path = strdup(path);
+    server.mutex = SDL_CreateMutex();
+    server.cond = SDL_CreateCond();
+    if (server.mutex != NULL && server.cond != NULL)
+        server.thread = SDL_CreateThread(control_thread, CONTROL_THREAD_NAME, NULL);
+    if (server.thread == NULL) {
+        log_error("Could not start control thread\n%s", SDL_GetError());
+        quit_control();
+        return 1;
+    }
+    log_debug("Listening for commands on %s", path);
+    return 0;
+}
+
+// A function to stop the control thread and remove the socket
+void quit_control()
+{
+    if (server.mutex != NULL) {
+        SDL_LockMutex(server.mutex);
+        server.quit = true;
+        SDL_CondBroadcast(server.cond);
+
+        // Unblock the thread if it is waiting on a client or a new connection
+        if (server.client_fd >= 0)
+            shutdown(server.client_fd, SHUT_RDWR);
+        SDL_UnlockMutex(server.mutex);
+    }
+    if (server.listen_fd >= 0)
+        shutdown(server.listen_fd, SHUT_RDWR);
+    if (server.thread != NULL)
+        SDL_WaitThread(server.thread, NULL);
+    if (server.listen_fd >= 0)
+        close(server.listen_fd);
+    if (server.path != NULL)
+        unlink(server.path);
+    SDL_DestroyCond(server.cond);
+    SDL_DestroyMutex(server.mutex);
+    free(server.path);
+    server = (ControlServer) {.listen_fd = -1, .client_fd = -1};
+}
+
+// A function to run the commands of a waiting batch on the main thread
+void process_control_requests(ControlHandler handler)
+{
+    if (server.mutex == NULL)
+        return;
+    SDL_LockMutex(server.mutex);
+    ControlBatch *pending = server.batch;
+    server.batch = NULL;
+    SDL_UnlockMutex(server.mutex);
+    if (pending == NULL)
+        return;
+
+    // The handler may quit the program, so the lock is not held while it runs
+    for (int i = 0; i < pending->num_requests; i++) {
+        char *reply = pending->requests[i].reply;
+        reply[0] = '\0';
+        handler(pending->requests + i);
+
+        // Terminate every reply with a newline, even if it was truncated
+        size_t length = strnlen(reply, CONTROL_REPLY_SIZE - 2);
+        reply[length] = '\n';
+        reply[length + 1] = '\0';
+    }
+    SDL_LockMutex(server.mutex);
+    pending->done = true;
+    SDL_CondSignal(server.cond);
+    SDL_UnlockMutex(server.mutex);
+}
+
+// A function to write a whole buffer to a client
+static bool write_all(int fd, const char *buffer, size_t length)
+{
+    while (length) {
+        ssize_t written = send(fd, buffer, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        buffer += written;
+        length -= (size_t) written;
+    }
+    return true;
+}
+
+// A function to hand a batch to the main thread, wait for it to run and
+// write the replies back in order. Returns false if the client is gone or
+// the program is quitting
+static bool run_batch(int fd, ControlBatch *batch)
+{
+    SDL_LockMutex(server.mutex);
+    batch->done = false;
+    server.batch = batch;
+    SDL_UnlockMutex(server.mutex);
+
+    // Wake the main loop if it is waiting for events
+    SDL_Event event = {0};
+    event.type = server.event_type;
+    SDL_PushEvent(&event);
+
+    SDL_LockMutex(server.mutex);
+    while (!batch->done && !server.quit)
+        SDL_CondWait(server.cond, server.mutex);
+    bool quit = server.quit;
+    SDL_UnlockMutex(server.mutex);
+    if (quit)
+        return false;
+
+    bool connected = true;
+    for (int i = 0; i < batch->num_requests && connected; i++)
+        connected = write_all(fd, batch->requests[i].reply, strlen(batch->requests[i].reply));
+    batch->num_requests = 0;
+    return connected;
+}
+
+// A function to read newline separated commands from a client until it
+// disconnects. All complete lines from one read are run as one batch, so
+// pipelined commands cost one trip through the main loop
+static void serve_client(int fd)
+{
+    char input[CONTROL_MAX_LINE];
+    size_t used = 0;
+    bool discard = false; // Skipping the rest of a line that was too long
+    batch.num_requests = 0;
+    while (1) {
+        ssize_t bytes = read(fd, input + used, sizeof(input) - used);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            return;
+        used += (size_t) bytes;
+
+        // Split off every complete line
+        char *start = input;
+        char *end;
+        while ((end = memchr(start, '\n', used - (size_t) (start - input))) != NULL) {
+            *end = '\0';
+            if (end > start && end[-1] == '\r')
+                end[-1] = '\0';
+            if (discard)
+                discard = false;
+            else if (*start != '\0') {
+                strcpy(batch.requests[batch.num_requests].command, start);
+                batch.num_requests++;
+                if (batch.num_requests == CONTROL_MAX_BATCH && !run_batch(fd, &batch))
+                    return;
+            }
+            start = end + 1;
+        }
+        used -= (size_t) (start - input);
+        memmove(input, start, used);
+
+        if (batch.num_requests && !run_batch(fd, &batch))
+            return;
+
+        // A line that fills the whole buffer can never complete
+        if (used == sizeof(input)) {
+            if (!discard) {
+                const char *reply = "ERR Command too long\n";
+                if (!write_all(fd, reply, strlen(reply)))
+                    return;
+            }
+            discard = true;
+            used = 0;
+        }
+    }
+}
+
+// A function run by the control thread to accept clients one at a time
+static int control_thread(void *data)
+{
+    UNUSED(data);
+    set_trace_thread_name(CONTROL_THREAD_NAME);
+    while (1) {
+        int fd = accept(server.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        // Launched applications must not inherit the connection
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        SDL_LockMutex(server.mutex);
+        bool quit = server.quit;
+        if (!quit)
+            server.client_fd = fd;
+        SDL_UnlockMutex(server.mutex);
+        if (!quit)
+            serve_client(fd);
+        SDL_LockMutex(server.mutex);
+        server.client_fd = -1;
+        SDL_UnlockMutex(server.mutex);
+        close(fd);
+        if (quit)
+            break;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#define CONTROL_THREAD_NAME "Control Thread"
+#define CONTROL_MAX_LINE 1024
+#define CONTROL_MAX_BATCH 32
+#define CONTROL_REPLY_SIZE 512
+#define CONTROL_BACKLOG 4
+
+// One command line received from a client and the reply written back
+typedef struct {
+    char command[CONTROL_MAX_LINE];
+    char reply[CONTROL_REPLY_SIZE];
+} ControlRequest;
+
+// Commands read together from a client, run in one pass of the main loop
+typedef struct {
+    ControlRequest requests[CONTROL_MAX_BATCH];
+    int            num_requests;
+    bool           done;
+} ControlBatch;
+
+typedef void (*ControlHandler)(ControlRequest *request);
+
+// Unix domain socket served by a single thread, one client at a time
+typedef struct {
+    SDL_Thread   *thread;
+    SDL_mutex    *mutex; // Guards batch, done, client_fd and quit
+    SDL_cond     *cond;
+    ControlBatch *batch; // Batch waiting for the main thread
+    int          listen_fd;
+    int          client_fd;
+    char         *path;
+    bool         quit;
+    Uint32       event_type;
+} ControlServer;
+
+int init_control(const char *path);
+void quit_control(void);
+void process_control_requests(ControlHandler handler);
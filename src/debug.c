@@ -8,15 +8,22 @@
 #include <launcher_config.h>
 #include "util.h"
 #include "debug.h"
+#include "metrics.h"
 #include "platform/platform.h"
 #ifdef __unix__
 #include "platform/unix.h"
 #endif
 
 static int init_log(void);
+static int log_writer_thread(void *data);
+static bool write_log_records(void);
+static void write_log_record(LogRecord *record);
 
 extern Config config;
 extern FILE *log_file;
+static LogRing log_ring;
+static bool log_closed = false;
+static SDL_SpinLock log_init_lock = 0;
 
 // A function to initialize the logging subsystem
 static int init_log()
@@ -38,6 +45,7 @@ static int init_log()
 #ifdef __unix__
         printf("Failed to create log file");
 #endif
+        log_closed = true;
         quit(EXIT_FAILURE);
     }
 print_version(log_file);
@@ -48,6 +56,67 @@ fputs("\n", log_file);
     if (config.debug)
         printf("Debug mode enabled\nLog is outputted to %s\n", log_file_path);
 #endif
+
+    // Start the writer thread, records are written synchronously if this fails
+    for (unsigned int i = 0; i < LOG_RING_SIZE; i++)
+        SDL_AtomicSet(&log_ring.records[i].sequence, (int) i);
+    SDL_AtomicSet(&log_ring.enqueue_position, 0);
+    log_ring.dequeue_position = 0;
+    log_ring.semaphore = SDL_CreateSemaphore(0);
+    if (log_ring.semaphore != NULL)
+        log_ring.thread = SDL_CreateThread(log_writer_thread, LOG_WRITER_THREAD_NAME, NULL);
+    return 0;
+}
+
+// A function to write a single record to the log file
+static void write_log_record(LogRecord *record)
+{
+    int bytes = fprintf(log_file,
+        "[%6u.%03u] [%lu] %s",
+        record->timestamp / 1000,
+        record->timestamp % 1000,
+        (unsigned long) record->thread_id,
+        record->text
+    );
+    if (bytes > 0)
+        ADD_COUNTER(log_bytes, bytes);
+#ifdef __unix__
+    if (record->log_level > LOGLEVEL_DEBUG)
+        fputs(record->text, stderr);
+#endif
+}
+
+// A function to write all published records in the ring, returns false if there were none
+static bool write_log_records()
+{
+    bool written = false;
+    while (1) {
+        unsigned int position = log_ring.dequeue_position;
+        LogRecord *record = log_ring.records + (position & (LOG_RING_SIZE - 1));
+        if ((unsigned int) SDL_AtomicGet(&record->sequence) != position + 1)
+            break;
+        write_log_record(record);
+
+        // Hand the slot back to producers for the next lap around the ring
+        SDL_AtomicSet(&record->sequence, (int) (position + LOG_RING_SIZE));
+        log_ring.dequeue_position++;
+        written = true;
+    }
+    if (written) {
+        fflush(log_file);
+        SDL_AtomicSet(&log_ring.written, (int) log_ring.dequeue_position);
+    }
+    return written;
+}
+
+// A function run by the writer thread to batch log records to disk
+static int log_writer_thread(void *data)
+{
+    while (!SDL_AtomicGet(&log_ring.quit)) {
+        if (!write_log_records())
+            SDL_SemWaitTimeout(log_ring.semaphore, LOG_FLUSH_PERIOD);
+    }
+    write_log_records();
     return 0;
 }
 
@@ -59,26 +128,91 @@ void output_log(LogLevel log_level, const char *format, ...)
         return;
 
     // Initialize logging if not already initialized
-    if (log_file == NULL)
-        init_log();
-    
-    // Output log
-    static char buffer[MAX_LOG_LINE_BYTES];
+    if (log_file == NULL && !log_closed) {
+        SDL_AtomicLock(&log_init_lock);
+        if (log_file == NULL && !log_closed)
+            init_log();
+        SDL_AtomicUnlock(&log_init_lock);
+    }
     va_list args;
     va_start(args, format);
-    size_t length = (size_t) vsnprintf(buffer, MAX_LOG_LINE_BYTES - 1, format, args);
-    fwrite(buffer, 1, length, log_file);
-    if (config.debug)
-        fflush(log_file);
-    
+
+    // Write synchronously if the writer thread isn't running
+    if (log_ring.thread == NULL) {
+        LogRecord record = {
+            .log_level = log_level,
+            .timestamp = SDL_GetTicks(),
+            .thread_id = SDL_ThreadID()
+        };
+        vsnprintf(record.text, sizeof(record.text), format, args);
+        va_end(args);
+        if (log_file != NULL) {
+            write_log_record(&record);
+            fflush(log_file);
+        }
+
+        // The log is closed after quit_log(), errors still reach the terminal
 #ifdef __unix__
-    if (log_level > LOGLEVEL_DEBUG)
-        fputs(buffer, stderr);
+        else if (log_level > LOGLEVEL_DEBUG)
+            fputs(record.text, stderr);
 #endif
+        if (log_level == LOGLEVEL_FATAL)
+            quit(EXIT_FAILURE);
+        return;
+    }
+
+    // Claim a free slot, waiting for the writer if the ring is full
+    unsigned int position;
+    LogRecord *record;
+    while (1) {
+        position = (unsigned int) SDL_AtomicGet(&log_ring.enqueue_position);
+        record = log_ring.records + (position & (LOG_RING_SIZE - 1));
+        int difference = (int) ((unsigned int) SDL_AtomicGet(&record->sequence) - position);
+        if (difference == 0) {
+            if (SDL_AtomicCAS(&log_ring.enqueue_position, (int) position, (int) (position + 1)))
+                break;
+        }
+        else if (difference < 0) {
+            SDL_SemPost(log_ring.semaphore);
+            SDL_Delay(1);
+        }
+    }
+
+    // Format directly into the slot and publish it
+    record->log_level = log_level;
+    record->timestamp = SDL_GetTicks();
+    record->thread_id = SDL_ThreadID();
+    vsnprintf(record->text, sizeof(record->text), format, args);
     va_end(args);
+    SDL_AtomicSet(&record->sequence, (int) (position + 1));
+    if (log_level > LOGLEVEL_DEBUG)
+        SDL_SemPost(log_ring.semaphore);
 
-    if (log_level == LOGLEVEL_FATAL)
+    // Make sure a fatal error reaches the disk before quitting
+    if (log_level == LOGLEVEL_FATAL) {
+        while ((int) ((unsigned int) SDL_AtomicGet(&log_ring.written) - (position + 1)) < 0)
+            SDL_Delay(1);
         quit(EXIT_FAILURE);
+    }
+}
+
+// A function to stop the writer thread, write the remaining records and
+// close the log. Later errors are only printed to stderr
+void quit_log()
+{
+    if (log_ring.thread != NULL) {
+        SDL_AtomicSet(&log_ring.quit, 1);
+        SDL_SemPost(log_ring.semaphore);
+        SDL_WaitThread(log_ring.thread, NULL);
+        log_ring.thread = NULL;
+        SDL_DestroySemaphore(log_ring.semaphore);
+        log_ring.semaphore = NULL;
+    }
+    if (log_file != NULL) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+    log_closed = true;
 }
 
 void print_compiler_info(FILE *stream)
@@ -101,13 +235,17 @@ void debug_settings()
     DEBUG_BOOL(SETTING_VSYNC, config.vsync);
     DEBUG_INT(SETTING_FPS_LIMIT, config.fps_limit);
     DEBUG_INT(SETTING_APPLICATION_TIMEOUT, config.application_timeout / 1000);
+    DEBUG_INT(SETTING_TEXTURE_MEMORY_LIMIT, (int) (config.texture_memory_limit / BYTES_PER_MEGABYTE));
     DEBUG_MODE(SETTING_ON_LAUNCH, MODE_SETTING_ON_LAUNCH, config.on_launch);
     DEBUG_BOOL(SETTING_WRAP_ENTRIES, config.wrap_entries);
+    DEBUG_BOOL(SETTING_ANIMATED_NAVIGATION, config.animated_navigation);
     DEBUG_BOOL(SETTING_RESET_ON_BACK, config.reset_on_back);
     DEBUG_BOOL(SETTING_MOUSE_SELECT, config.mouse_select);
     DEBUG_BOOL(SETTING_INHIBIT_OS_SCREENSAVER, config.inhibit_os_screensaver);
     DEBUG_STR(SETTING_STARTUP_CMD, config.startup_cmd);
     DEBUG_STR(SETTING_QUIT_CMD, config.quit_cmd);
+    DEBUG_STR(SETTING_CONTROL_SOCKET, config.control_socket);
+    DEBUG_STR(SETTING_METRICS_FILE, config.metrics_file);
     log_debug("");
 
     log_debug("===================== Background =======================\n");
@@ -126,6 +264,7 @@ void debug_settings()
     DEBUG_INT(SETTING_ICON_SIZE, config.icon_size);
     DEBUG_INT(SETTING_ICON_SPACING, config.icon_spacing);
     DEBUG_STR(SETTING_VCENTER, config.vcenter[0] != '\0' ? config.vcenter : "50%");
+    DEBUG_INT(SETTING_ROWS, config.rows);
     log_debug("");
 
     log_debug("======================== Titles ========================\n");
@@ -236,15 +375,15 @@ void debug_hotkeys(Hotkey *hotkeys)
 }
 
 // A function to debug the parsed slideshow files
-void debug_slideshow(Slideshow *slideshow)
+void debug_slideshow(SlideshowImage **images, int num_images)
 {
     log_debug("======================== Slideshow ========================");
     log_debug("Found %i images in directory %s:", 
-      slideshow->num_images, 
+      num_images, 
       config.slideshow_directory
     );
-    for (int i = 0; i < slideshow->num_images; i++)
-        log_debug("  %s", slideshow->images[slideshow->order[i]]);
+    for (int i = 0; i < num_images; i++)
+        log_debug("  %s", images[i]->path);
 }
 
 // A function to debug the video settings
@@ -4,14 +4,40 @@ typedef enum {
     LOGLEVEL_FATAL
 } LogLevel;
 
+#define MAX_LOG_LINE_BYTES 501
+#define LOG_RING_SIZE 256 // Must be a power of two
+#define LOG_FLUSH_PERIOD 100
+#define LOG_WRITER_THREAD_NAME "Log Thread"
+
+// Preformatted log line waiting in the ring buffer
+typedef struct {
+    SDL_atomic_t sequence; // Equal to the position when free, position + 1 when filled
+    LogLevel     log_level;
+    Uint32       timestamp;
+    SDL_threadID thread_id;
+    char         text[MAX_LOG_LINE_BYTES];
+} LogRecord;
+
+// Bounded multi-producer, single-consumer ring of log records drained by a writer thread
+typedef struct {
+    LogRecord    records[LOG_RING_SIZE];
+    SDL_atomic_t enqueue_position;
+    unsigned int dequeue_position; // Only accessed by the writer thread
+    SDL_atomic_t written; // Number of records written and flushed
+    SDL_atomic_t quit;
+    SDL_sem      *semaphore;
+    SDL_Thread   *thread;
+} LogRing;
+
 void output_log(LogLevel log_level, const char *format, ...);
+void quit_log(void);
 void print_compiler_info(FILE *stream);
 void debug_video(SDL_Renderer *renderer, SDL_DisplayMode *display_mode);
 void debug_settings(void);
 void debug_gamepad(GamepadControl *gamepad_controls);
 void debug_hotkeys(Hotkey *hotkeys);
 void debug_menu_entries(Menu *first_menu, size_t num_menus);
-void debug_slideshow(Slideshow *slideshow);
+void debug_slideshow(SlideshowImage **images, int num_images);
 void debug_button_positions(Entry *entry, Menu *current_menu, Geometry *geo);
 
 #ifdef _WIN32
@@ -65,6 +65,12 @@ void nsvgRasterize(NSVGrasterizer* r,
 // Deletes rasterizer context.
 void nsvgDeleteRasterizer(NSVGrasterizer*);
 
+// Enables or disables the SSE2/NEON scanline paths, if they were compiled in.
+// They are enabled by default and produce the same output as the scalar paths.
+//   r - pointer to rasterizer context
+//   enabled - non-zero to use the SIMD paths
+void nsvgSetRasterizerSIMD(NSVGrasterizer* r, int enabled);
+
 
 #ifndef NANOSVGRAST_CPLUSPLUS
 #ifdef __cplusplus
@@ -78,6 +84,16 @@ void nsvgDeleteRasterizer(NSVGrasterizer*);
 
 #include <math.h>
 
+#ifndef NSVG_NO_SIMD
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NSVG__SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NSVG__NEON 1
+#endif
+#endif
+
 #define NSVG__SUBSAMPLES	5
 #define NSVG__FIXSHIFT		10
 #define NSVG__FIX			(1 << NSVG__FIXSHIFT)
@@ -146,6 +162,8 @@ struct NSVGrasterizer
 
 	unsigned char* bitmap;
 	int width, height, stride;
+
+	int simd;
 };
 
 NSVGrasterizer* nsvgCreateRasterizer()
@@ -156,6 +174,9 @@ NSVGrasterizer* nsvgCreateRasterizer()
 
 	r->tessTol = 0.25f;
 	r->distTol = 0.01f;
+#if defined(NSVG__SSE2) || defined(NSVG__NEON)
+	r->simd = 1;
+#endif
 
 	return r;
 
@@ -164,6 +185,16 @@ error:
 	return NULL;
 }
 
+void nsvgSetRasterizerSIMD(NSVGrasterizer* r, int enabled)
+{
+#if defined(NSVG__SSE2) || defined(NSVG__NEON)
+	r->simd = enabled;
+#else
+	(void)enabled;
+	r->simd = 0;
+#endif
+}
+
 void nsvgDeleteRasterizer(NSVGrasterizer* r)
 {
 	NSVGmemPage* p;
@@ -888,7 +919,31 @@ static void nsvg__freeActive(NSVGrasterizer* r, NSVGactiveEdge* z)
 	r->freelist = z;
 }
 
-static void nsvg__fillScanline(unsigned char* scanline, int len, int x0, int x1, int maxWeight, int* xmin, int* xmax)
+// Adds a constant coverage weight to a run of pixels, wrapping like the scalar byte add
+static void nsvg__addCoverage(unsigned char* scanline, int i, int j, int maxWeight, int simd)
+{
+#if defined(NSVG__SSE2)
+	if (simd) {
+		__m128i w = _mm_set1_epi8((char)maxWeight);
+		for (; i + 16 <= j; i += 16) {
+			__m128i c = _mm_loadu_si128((__m128i*)&scanline[i]);
+			_mm_storeu_si128((__m128i*)&scanline[i], _mm_add_epi8(c, w));
+		}
+	}
+#elif defined(NSVG__NEON)
+	if (simd) {
+		uint8x16_t w = vdupq_n_u8((uint8_t)maxWeight);
+		for (; i + 16 <= j; i += 16)
+			vst1q_u8(&scanline[i], vaddq_u8(vld1q_u8(&scanline[i]), w));
+	}
+#else
+	(void)simd;
+#endif
+	for (; i < j; ++i)
+		scanline[i] = (unsigned char)(scanline[i] + maxWeight);
+}
+
+static void nsvg__fillScanline(unsigned char* scanline, int len, int x0, int x1, int maxWeight, int* xmin, int* xmax, int simd)
 {
 	int i = x0 >> NSVG__FIXSHIFT;
 	int j = x1 >> NSVG__FIXSHIFT;
@@ -909,8 +964,7 @@ static void nsvg__fillScanline(unsigned char* scanline, int len, int x0, int x1,
 			else
 				j = len; // clip
 
-			for (++i; i < j; ++i) // fill pixels between x0 and x1
-				scanline[i] = (unsigned char)(scanline[i] + maxWeight);
+			nsvg__addCoverage(scanline, i + 1, j, maxWeight, simd); // fill pixels between x0 and x1
 		}
 	}
 }
@@ -918,7 +972,7 @@ static void nsvg__fillScanline(unsigned char* scanline, int len, int x0, int x1,
 // note: this routine clips fills that extend off the edges... ideally this
 // wouldn't happen, but it could happen if the truetype glyph bounding boxes
 // are wrong, or if the user supplies a too-small bitmap
-static void nsvg__fillActiveEdges(unsigned char* scanline, int len, NSVGactiveEdge* e, int maxWeight, int* xmin, int* xmax, char fillRule)
+static void nsvg__fillActiveEdges(unsigned char* scanline, int len, NSVGactiveEdge* e, int maxWeight, int* xmin, int* xmax, char fillRule, int simd)
 {
 	// non-zero winding fill
 	int x0 = 0, w = 0;
@@ -933,7 +987,7 @@ static void nsvg__fillActiveEdges(unsigned char* scanline, int len, NSVGactiveEd
 				int x1 = e->x; w += e->dir;
 				// if we went to zero, we need to draw
 				if (w == 0)
-					nsvg__fillScanline(scanline, len, x0, x1, maxWeight, xmin, xmax);
+					nsvg__fillScanline(scanline, len, x0, x1, maxWeight, xmin, xmax, simd);
 			}
 			e = e->next;
 		}
@@ -945,7 +999,7 @@ static void nsvg__fillActiveEdges(unsigned char* scanline, int len, NSVGactiveEd
 				x0 = e->x; w = 1;
 			} else {
 				int x1 = e->x; w = 0;
-				nsvg__fillScanline(scanline, len, x0, x1, maxWeight, xmin, xmax);
+				nsvg__fillScanline(scanline, len, x0, x1, maxWeight, xmin, xmax, simd);
 			}
 			e = e->next;
 		}
@@ -984,9 +1038,122 @@ static inline int nsvg__div255(int x)
     return ((x+1) * 257) >> 16;
 }
 
+// Looks up the gradient color at a point, shared by the scalar and SIMD paths
+static inline unsigned int nsvg__linearGradientColor(NSVGcachedPaint* cache, float fx, float fy)
+{
+	float* t = cache->xform;
+	float gy = fx*t[1] + fy*t[3] + t[5];
+	return cache->colors[(int)nsvg__clampf(gy*255.0f, 0, 255.0f)];
+}
+
+static inline unsigned int nsvg__radialGradientColor(NSVGcachedPaint* cache, float fx, float fy)
+{
+	float* t = cache->xform;
+	float gx = fx*t[0] + fy*t[2] + t[4];
+	float gy = fx*t[1] + fy*t[3] + t[5];
+	float gd = sqrtf(gx*gx + gy*gy);
+	return cache->colors[(int)nsvg__clampf(gd*255.0f, 0, 255.0f)];
+}
+
+#if defined(NSVG__SSE2)
+// Computes nsvg__div255(a*b) for 16-bit lanes where a*b <= 255*255
+static inline __m128i nsvg__mulDiv255SSE2(__m128i a, __m128i b)
+{
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(1));
+	return _mm_mulhi_epu16(x, _mm_set1_epi16(257));
+}
+
+// Blends two RGBA pixels held in 16-bit lanes over the destination
+static inline __m128i nsvg__blendSSE2(__m128i color, __m128i cover, __m128i dst)
+{
+	const __m128i rgbMask = _mm_set_epi16(0, 0xff, 0xff, 0xff, 0, 0xff, 0xff, 0xff);
+	const __m128i alphaOne = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+	// Broadcast each pixel's color alpha across its lanes
+	__m128i ca = _mm_shufflehi_epi16(_mm_shufflelo_epi16(color, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+	__m128i a = nsvg__mulDiv255SSE2(cover, ca);
+	__m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	// Premultiply, the alpha lane multiplies by 255 which leaves a unchanged
+	__m128i src = nsvg__mulDiv255SSE2(_mm_or_si128(_mm_and_si128(color, rgbMask), alphaOne), a);
+	__m128i res = _mm_add_epi16(src, nsvg__mulDiv255SSE2(ia, dst));
+	// Truncate to 8 bits like the scalar cast before packing
+	return _mm_and_si128(res, _mm_set1_epi16(0xff));
+}
+
+// Blends four pixels with individual colors and coverage
+static inline void nsvg__blend4SSE2(unsigned char* dst, const unsigned char* cover, __m128i colors)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int c4 = cover[0] | (cover[1] << 8) | (cover[2] << 16) | (cover[3] << 24);
+	__m128i c = _mm_cvtsi32_si128(c4);
+	c = _mm_unpacklo_epi8(c, c);
+	c = _mm_unpacklo_epi16(c, c);
+	__m128i d = _mm_loadu_si128((__m128i*)dst);
+	__m128i lo = nsvg__blendSSE2(_mm_unpacklo_epi8(colors, zero), _mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero));
+	__m128i hi = nsvg__blendSSE2(_mm_unpackhi_epi8(colors, zero), _mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero));
+	_mm_storeu_si128((__m128i*)dst, _mm_packus_epi16(lo, hi));
+}
+#elif defined(NSVG__NEON)
+// Computes nsvg__div255(a*b) for 16-bit lanes where a*b <= 255*255
+static inline uint16x8_t nsvg__mulDiv255NEON(uint16x8_t a, uint16x8_t b)
+{
+	uint16x8_t x = vaddq_u16(vmulq_u16(a, b), vdupq_n_u16(1));
+	// ((x*257) >> 16) == ((x + (x >> 8)) >> 8) for x <= 65536
+	return vshrq_n_u16(vsraq_n_u16(x, x, 8), 8);
+}
+
+// Blends two RGBA pixels held in 16-bit lanes over the destination
+static inline uint16x8_t nsvg__blendNEON(uint16x8_t color, uint16x8_t cover, uint16x8_t dst)
+{
+	static const uint16_t rgbMask[8] = { 0xff, 0xff, 0xff, 0, 0xff, 0xff, 0xff, 0 };
+	static const uint16_t alphaOne[8] = { 0, 0, 0, 0xff, 0, 0, 0, 0xff };
+	uint16x4_t clo = vget_low_u16(color), chi = vget_high_u16(color);
+	uint16x8_t ca = vcombine_u16(vdup_lane_u16(clo, 3), vdup_lane_u16(chi, 3));
+	uint16x8_t a = nsvg__mulDiv255NEON(cover, ca);
+	uint16x8_t ia = vsubq_u16(vdupq_n_u16(255), a);
+	uint16x8_t src = nsvg__mulDiv255NEON(vorrq_u16(vandq_u16(color, vld1q_u16(rgbMask)), vld1q_u16(alphaOne)), a);
+	return vaddq_u16(src, nsvg__mulDiv255NEON(ia, dst));
+}
+
+// Blends four pixels with individual colors and coverage
+static inline void nsvg__blend4NEON(unsigned char* dst, const unsigned char* cover, uint8x16_t colors)
+{
+	static const uint8_t coverIndex[16] = { 0,0,0,0, 1,1,1,1, 2,2,2,2, 3,3,3,3 };
+	uint8_t c4[8] = { cover[0], cover[1], cover[2], cover[3], 0, 0, 0, 0 };
+	uint8x8_t c8 = vld1_u8(c4);
+	uint8x16_t c = vcombine_u8(vtbl1_u8(c8, vld1_u8(coverIndex)), vtbl1_u8(c8, vld1_u8(coverIndex + 8)));
+	uint8x16_t d = vld1q_u8(dst);
+	uint16x8_t lo = nsvg__blendNEON(vmovl_u8(vget_low_u8(colors)), vmovl_u8(vget_low_u8(c)), vmovl_u8(vget_low_u8(d)));
+	uint16x8_t hi = nsvg__blendNEON(vmovl_u8(vget_high_u8(colors)), vmovl_u8(vget_high_u8(c)), vmovl_u8(vget_high_u8(d)));
+	// Narrowing keeps the low 8 bits like the scalar cast
+	vst1q_u8(dst, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+}
+#endif
+
+// Blends a run of pixels, four at a time, returns the number of pixels blended
+static int nsvg__blendSpan(unsigned char* dst, int count, const unsigned char* cover, const unsigned int* colors, int step)
+{
+	int i = 0;
+#if defined(NSVG__SSE2)
+	for (; i + 4 <= count; i += 4) {
+		const unsigned int* c = &colors[i*step];
+		nsvg__blend4SSE2(&dst[i*4], &cover[i], _mm_set_epi32((int)c[3*step], (int)c[2*step], (int)c[step], (int)c[0]));
+	}
+#elif defined(NSVG__NEON)
+	for (; i + 4 <= count; i += 4) {
+		const unsigned int* c = &colors[i*step];
+		uint32_t c4[4] = { c[0], c[step], c[2*step], c[3*step] };
+		nsvg__blend4NEON(&dst[i*4], &cover[i], vreinterpretq_u8_u32(vld1q_u32(c4)));
+	}
+#else
+	(void)dst; (void)count; (void)cover; (void)colors; (void)step;
+#endif
+	return i;
+}
+
 static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* cover, int x, int y,
-								float tx, float ty, float scale, NSVGcachedPaint* cache)
+								float tx, float ty, float scale, NSVGcachedPaint* cache, int simd)
 {
+	unsigned int colors[4];
 
 	if (cache->type == NSVG_PAINT_COLOR) {
 		int i, cr, cg, cb, ca;
@@ -995,7 +1162,13 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 		cb = (cache->colors[0] >> 16) & 0xff;
 		ca = (cache->colors[0] >> 24) & 0xff;
 
-		for (i = 0; i < count; i++) {
+		i = 0;
+		if (simd) {
+			i = nsvg__blendSpan(dst, count, cover, cache->colors, 0);
+			cover += i;
+			dst += i*4;
+		}
+		for (; i < count; i++) {
 			int r,g,b;
 			int a = nsvg__div255((int)cover[0] * ca);
 			int ia = 255 - a;
@@ -1021,8 +1194,7 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 	} else if (cache->type == NSVG_PAINT_LINEAR_GRADIENT) {
 		// TODO: spread modes.
 		// TODO: plenty of opportunities to optimize.
-		float fx, fy, dx, gy;
-		float* t = cache->xform;
+		float fx, fy, dx;
 		int i, cr, cg, cb, ca;
 		unsigned int c;
 
@@ -1030,10 +1202,22 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 		fy = ((float)y - ty) / scale;
 		dx = 1.0f / scale;
 
-		for (i = 0; i < count; i++) {
+		i = 0;
+		if (simd) {
+			for (; i + 4 <= count; i += 4) {
+				int k;
+				for (k = 0; k < 4; k++) {
+					colors[k] = nsvg__linearGradientColor(cache, fx, fy);
+					fx += dx;
+				}
+				nsvg__blendSpan(dst, 4, cover, colors, 1);
+				cover += 4;
+				dst += 16;
+			}
+		}
+		for (; i < count; i++) {
 			int r,g,b,a,ia;
-			gy = fx*t[1] + fy*t[3] + t[5];
-			c = cache->colors[(int)nsvg__clampf(gy*255.0f, 0, 255.0f)];
+			c = nsvg__linearGradientColor(cache, fx, fy);
 			cr = (c) & 0xff;
 			cg = (c >> 8) & 0xff;
 			cb = (c >> 16) & 0xff;
@@ -1066,8 +1250,7 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 		// TODO: spread modes.
 		// TODO: plenty of opportunities to optimize.
 		// TODO: focus (fx,fy)
-		float fx, fy, dx, gx, gy, gd;
-		float* t = cache->xform;
+		float fx, fy, dx;
 		int i, cr, cg, cb, ca;
 		unsigned int c;
 
@@ -1075,12 +1258,22 @@ static void nsvg__scanlineSolid(unsigned char* dst, int count, unsigned char* co
 		fy = ((float)y - ty) / scale;
 		dx = 1.0f / scale;
 
-		for (i = 0; i < count; i++) {
+		i = 0;
+		if (simd) {
+			for (; i + 4 <= count; i += 4) {
+				int k;
+				for (k = 0; k < 4; k++) {
+					colors[k] = nsvg__radialGradientColor(cache, fx, fy);
+					fx += dx;
+				}
+				nsvg__blendSpan(dst, 4, cover, colors, 1);
+				cover += 4;
+				dst += 16;
+			}
+		}
+		for (; i < count; i++) {
 			int r,g,b,a,ia;
-			gx = fx*t[0] + fy*t[2] + t[4];
-			gy = fx*t[1] + fy*t[3] + t[5];
-			gd = sqrtf(gx*gx + gy*gy);
-			c = cache->colors[(int)nsvg__clampf(gd*255.0f, 0, 255.0f)];
+			c = nsvg__radialGradientColor(cache, fx, fy);
 			cr = (c) & 0xff;
 			cg = (c >> 8) & 0xff;
 			cb = (c >> 16) & 0xff;
@@ -1188,26 +1381,78 @@ static void nsvg__rasterizeSortedEdges(NSVGrasterizer *r, float tx, float ty, fl
 
 			// now process all active edges in non-zero fashion
 			if (active != NULL)
-				nsvg__fillActiveEdges(r->scanline, r->width, active, maxWeight, &xmin, &xmax, fillRule);
+				nsvg__fillActiveEdges(r->scanline, r->width, active, maxWeight, &xmin, &xmax, fillRule, r->simd);
 		}
 		// Blit
 		if (xmin < 0) xmin = 0;
 		if (xmax > r->width-1) xmax = r->width-1;
 		if (xmin <= xmax) {
-			nsvg__scanlineSolid(&r->bitmap[y * r->stride] + xmin*4, xmax-xmin+1, &r->scanline[xmin], xmin, y, tx,ty, scale, cache);
+			nsvg__scanlineSolid(&r->bitmap[y * r->stride] + xmin*4, xmax-xmin+1, &r->scanline[xmin], xmin, y, tx,ty, scale, cache, r->simd);
 		}
 	}
 
 }
 
-static void nsvg__unpremultiplyAlpha(unsigned char* image, int w, int h, int stride)
+// Unpremultiplies a row four pixels at a time, returns the number of pixels done.
+// c*255 and a are exact in single precision and the correctly rounded quotient
+// is always less than 1/512 from the exact one, while a non-integer quotient is
+// at least 1/255 from the next integer, so truncation matches integer division.
+static int nsvg__unpremultiplySpan(unsigned char* row, int w)
+{
+	int x = 0;
+#if defined(NSVG__SSE2)
+	const __m128i mask = _mm_set1_epi32(0xff);
+	const __m128 k255 = _mm_set1_ps(255.0f);
+	for (; x + 4 <= w; x += 4) {
+		__m128i p = _mm_loadu_si128((__m128i*)&row[x*4]);
+		__m128i a = _mm_srli_epi32(p, 24);
+		__m128 af = _mm_cvtepi32_ps(a);
+		__m128i r = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, mask)), k255), af));
+		__m128i g = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 8), mask)), k255), af));
+		__m128i b = _mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 16), mask)), k255), af));
+		__m128i res = _mm_or_si128(_mm_and_si128(r, mask), _mm_slli_epi32(_mm_and_si128(g, mask), 8));
+		res = _mm_or_si128(res, _mm_slli_epi32(_mm_and_si128(b, mask), 16));
+		res = _mm_or_si128(res, _mm_slli_epi32(a, 24));
+		// Leave fully transparent pixels untouched
+		__m128i zero = _mm_cmpeq_epi32(a, _mm_setzero_si128());
+		res = _mm_or_si128(_mm_and_si128(zero, p), _mm_andnot_si128(zero, res));
+		_mm_storeu_si128((__m128i*)&row[x*4], res);
+	}
+#elif defined(NSVG__NEON) && defined(__aarch64__)
+	const uint32x4_t mask = vdupq_n_u32(0xff);
+	for (; x + 4 <= w; x += 4) {
+		uint32x4_t p = vld1q_u32((const uint32_t*)&row[x*4]);
+		uint32x4_t a = vshrq_n_u32(p, 24);
+		float32x4_t af = vcvtq_f32_u32(a);
+		uint32x4_t r = vcvtq_u32_f32(vdivq_f32(vmulq_n_f32(vcvtq_f32_u32(vandq_u32(p, mask)), 255.0f), af));
+		uint32x4_t g = vcvtq_u32_f32(vdivq_f32(vmulq_n_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 8), mask)), 255.0f), af));
+		uint32x4_t b = vcvtq_u32_f32(vdivq_f32(vmulq_n_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(p, 16), mask)), 255.0f), af));
+		uint32x4_t res = vorrq_u32(vandq_u32(r, mask), vshlq_n_u32(vandq_u32(g, mask), 8));
+		res = vorrq_u32(res, vshlq_n_u32(vandq_u32(b, mask), 16));
+		res = vorrq_u32(res, vshlq_n_u32(a, 24));
+		// Leave fully transparent pixels untouched
+		res = vbslq_u32(vceqq_u32(a, vdupq_n_u32(0)), p, res);
+		vst1q_u32((uint32_t*)&row[x*4], res);
+	}
+#else
+	(void)row; (void)w;
+#endif
+	return x;
+}
+
+static void nsvg__unpremultiplyAlpha(unsigned char* image, int w, int h, int stride, int simd)
 {
 	int x,y;
 
 	// Unpremultiply
 	for (y = 0; y < h; y++) {
 		unsigned char *row = &image[y*stride];
-		for (x = 0; x < w; x++) {
+		x = 0;
+		if (simd) {
+			x = nsvg__unpremultiplySpan(row, w);
+			row += x*4;
+		}
+		for (; x < w; x++) {
 			int r = row[0], g = row[1], b = row[2], a = row[3];
 			if (a != 0) {
 				row[0] = (unsigned char)(r*255/a);
@@ -1441,7 +1686,7 @@ void nsvgRasterize(NSVGrasterizer* r,
 		}
 	}
 
-	nsvg__unpremultiplyAlpha(dst, w, h, stride);
+	nsvg__unpremultiplyAlpha(dst, w, h, stride, r->simd);
 
 	r->bitmap = NULL;
 	r->width = 0;
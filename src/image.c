@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <math.h>
 #include <SDL.h>
@@ -10,100 +11,524 @@
 #include "image.h"
 #include "util.h"
 #include "debug.h"
+#include "worker.h"
+#include "trace.h"
+#include "metrics.h"
+#include "arena.h"
+#include "scanner.h"
+#include "platform/platform.h"
 #include "external/ini.h"
+#if defined(BLEND_SSE2)
+#include <emmintrin.h>
+#elif defined(BLEND_NEON)
+#include <arm_neon.h>
+#endif
+#ifdef HAVE_LIBJPEG
+#include <setjmp.h>
+#include <jpeglib.h>
+
+// libjpeg error handler that returns to the decoder instead of exiting
+typedef struct {
+    struct jpeg_error_mgr manager;
+    jmp_buf jump;
+} JPEGError;
+#endif
 #define NANOSVG_IMPLEMENTATION
 #include <nanosvg.h>
 #define NANOSVGRAST_IMPLEMENTATION
 #include <nanosvgrast.h>
 
 extern Config config;
-extern State state;
+extern Arena config_arena;
 extern SDL_Renderer *renderer;
 extern SDL_Texture *background_texture;
-NSVGrasterizer *rasterizer = NULL;
+extern Uint32 texture_format;
+extern Geometry geo;
+extern State state;
+static SDL_TLSID rasterizer_tls = 0;
+static char cache_directory[MAX_PATH_CHARS + 1];
+static bool cache_enabled = false;
+static SVGCacheList cache_list;
+
+static void delete_rasterizer(void *data);
+static void flatten_background(SDL_Surface *surface);
+static void blend_overlay_row(Uint8 *pixels, int width, const Uint8 *color, Uint8 alpha);
+static void composite_background_overlay(SDL_Surface *surface, bool translucent);
+static inline Uint32 lerp_pixel(Uint32 a, Uint32 b, Uint32 weight);
+static inline Uint32 read_pixel(const Uint8 *row, int x, int bytes);
+static const PixelLayout *get_pixel_layout(Uint32 format);
+static bool scale_surface(SDL_Surface *source, const PixelLayout *layout, SDL_Surface *destination);
+static void orient_surface(SDL_Surface *source, SDL_Surface *destination, int orientation);
+static NSVGrasterizer *get_rasterizer(void);
+static Uint64 hash_buffer(const char *buffer, size_t size);
+static char *read_svg_file(const char *path, size_t *size);
+static unsigned char *read_svg_cache(const char *cache_path, int *width, int *height);
+static void write_svg_cache(const char *cache_path, unsigned char *pixels, int width, int height);
+static void add_svg_cache_file(const char *path, Sint64 size, Sint64 mtime);
+static int compare_svg_cache_files(const void *a, const void *b);
+static void prune_svg_cache(void);
+static void rasterize_icon(void *data);
+static void finish_icon(void *data);
+static void swizzle_pixels(Uint8 *pixels, size_t count);
+static SDL_Surface *convert_to_texture_format(SDL_Surface *surface, Uint32 *format);
+static SDL_Texture *create_texture(const void *pixels, int pitch, Uint32 format, int width, int height);
+static Uint32 convert_pixels(unsigned char *pixels, int width, int height);
+static SDL_Surface *load_image(const char *path, int width, int height);
+#ifdef HAVE_LIBJPEG
+static void exit_jpeg_error(j_common_ptr info);
+static void output_jpeg_message(j_common_ptr info);
+static SDL_Surface *load_jpeg(const char *path, int width, int height);
+#endif
 
 // A function to initalize SVG rasterization
 int init_svg()
 {
-    rasterizer = nsvgCreateRasterizer();
-    if (rasterizer == NULL) {
+    rasterizer_tls = SDL_TLSCreate();
+    if (!rasterizer_tls || get_rasterizer() == NULL) {
         log_fatal("Could not initialize SVG rasterizer.");
         return 1;
     }
+    cache_enabled = get_cache_directory(cache_directory, sizeof(cache_directory));
+    if (!cache_enabled)
+        log_error("Could not create cache directory, SVG icons will not be cached");
+    else
+        prune_svg_cache();
     return 0;
 }
 
 // A function to quit the SVG subsystem
 void quit_svg()
 {
-    nsvgDeleteRasterizer(rasterizer);
+    // Rasterizers of worker threads are deleted when the threads exit,
+    // the main thread's must be deleted manually
+    delete_rasterizer(SDL_TLSGet(rasterizer_tls));
+    SDL_TLSSet(rasterizer_tls, NULL, NULL);
+}
+
+// A function to delete a thread's rasterizer
+static void delete_rasterizer(void *data)
+{
+    if (data != NULL)
+        nsvgDeleteRasterizer((NSVGrasterizer*) data);
+}
+
+// A function to get the calling thread's rasterizer, creating it on first use
+static NSVGrasterizer *get_rasterizer()
+{
+    NSVGrasterizer *rasterizer = (NSVGrasterizer*) SDL_TLSGet(rasterizer_tls);
+    if (rasterizer == NULL) {
+        rasterizer = nsvgCreateRasterizer();
+        if (rasterizer != NULL) {
+            nsvgSetRasterizerSIMD(rasterizer, SDL_HasSSE2() || SDL_HasNEON());
+            SDL_TLSSet(rasterizer_tls, rasterizer, delete_rasterizer);
+        }
+    }
+    return rasterizer;
+}
+
+// A function to create the persistent textures and staging frame the
+// slideshow backgrounds are streamed through, so showing an image doesn't
+// allocate any textures
+bool create_slideshow_textures(Slideshow *slideshow, int width, int height)
+{
+    slideshow->staging = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, texture_format);
+    if (slideshow->staging == NULL) {
+        log_error("Could not create slideshow staging frame\n%s", SDL_GetError());
+        return false;
+    }
+    for (int i = 0; i < SLIDESHOW_TEXTURES; i++) {
+        slideshow->textures[i] = SDL_CreateTexture(renderer,
+                                     texture_format,
+                                     SDL_TEXTUREACCESS_STREAMING,
+                                     width,
+                                     height
+                                 );
+        if (slideshow->textures[i] == NULL) {
+            log_error("Could not create slideshow texture\n%s", SDL_GetError());
+            return false;
+        }
+        SDL_SetTextureBlendMode(slideshow->textures[i], SDL_BLENDMODE_BLEND);
+    }
+    return true;
+}
+
+#ifdef HAVE_LIBJPEG
+// A function to handle a fatal libjpeg error by jumping back to the decoder
+static void exit_jpeg_error(j_common_ptr info)
+{
+    JPEGError *error = (JPEGError*) info->err;
+    longjmp(error->jump, 1);
 }
 
-// A function to load the next slideshow background from the struct
-SDL_Surface *load_next_slideshow_background(Slideshow *slideshow, bool transition)
+// A function to log libjpeg warnings instead of printing them
+static void output_jpeg_message(j_common_ptr info)
 {
+    char message[JMSG_LENGTH_MAX];
+    info->err->format_message(info, message);
+    log_debug("libjpeg: %s", message);
+}
+
+// A function to decode a JPEG file with DCT scaling at the smallest of 1/2,
+// 1/4 or 1/8 scale that still covers the given size, which skips most of
+// the work and memory of decoding camera photos. Returns NULL if the file
+// is not a JPEG that libjpeg can decode to RGB, so it can be loaded with
+// SDL_image instead
+static SDL_Surface *load_jpeg(const char *path, int width, int height)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    Uint8 signature[2];
+    if (fread(signature, 1, sizeof(signature), file) != sizeof(signature) ||
+    signature[0] != 0xFF || signature[1] != 0xD8 ||
+    fseek(file, 0, SEEK_SET)) {
+        fclose(file);
+        return NULL;
+    }
+    struct jpeg_decompress_struct info;
+    JPEGError error;
+    SDL_Surface *volatile surface = NULL;
+    info.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = exit_jpeg_error;
+    error.manager.output_message = output_jpeg_message;
+    if (setjmp(error.jump)) {
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        SDL_FreeSurface(surface);
+        return NULL;
+    }
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = JCS_RGB;
+
+    // Halve the scale while the image still covers the target size
+    info.scale_num = 1;
+    info.scale_denom = 1;
+    while (info.scale_denom < 8) {
+        unsigned int denom = 2 * info.scale_denom;
+        if (DIV_ROUND_UP(info.image_width, denom) < (JDIMENSION) width ||
+        DIV_ROUND_UP(info.image_height, denom) < (JDIMENSION) height)
+            break;
+        info.scale_denom = denom;
+    }
+    jpeg_start_decompress(&info);
+    surface = SDL_CreateRGBSurfaceWithFormat(0,
+                  (int) info.output_width,
+                  (int) info.output_height,
+                  24,
+                  SDL_PIXELFORMAT_RGB24
+              );
+    if (surface == NULL) {
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        return NULL;
+    }
+    while (info.output_scanline < info.output_height) {
+        JSAMPROW row = (JSAMPROW) ((Uint8*) surface->pixels + info.output_scanline * (JDIMENSION) surface->pitch);
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    fclose(file);
+    return surface;
+}
+#endif
+
+// A function to decode an image file that is shown at a given size, JPEGs
+// are decoded at reduced resolution if libjpeg is available
+static SDL_Surface *load_image(const char *path, int width, int height)
+{
+#ifdef HAVE_LIBJPEG
+    SDL_Surface *surface = load_jpeg(path, width, height);
+    if (surface != NULL)
+        return surface;
+#else
+    UNUSED(width);
+    UNUSED(height);
+#endif
+    return IMG_Load(path);
+}
+
+// A function to decode the next loadable slideshow background, this
+// touches no global state so it can run on a worker thread
+SDL_Surface *decode_next_slideshow_background(Slideshow *slideshow)
+{
+    TRACE_BEGIN(decode_slideshow_background);
+    Uint64 decode_start = METRICS_START();
     SDL_Surface *surface = NULL;
-    int initial_index = slideshow->i;
+    int num_images = 0;
     int attempts = 0;
+    slideshow->next = NULL;
+
+    // Two passes try every image, the first may start part way through a
+    // shuffled cycle. Stop if the current image is the only one left.
+    // Images are verified against their files first, so the orientation is
+    // known and failures are recorded for the next cycles
     do {
-        // Increment slideshow background index and load background
-        (slideshow->i)++;
-        if (slideshow->i >= slideshow->num_images)
-            slideshow->i = 0;
-        surface = IMG_Load(slideshow->images[slideshow->order[slideshow->i]]);
-        
-        // If the loaded image has no alpha channel (e.g. JPEG), create one 
-        // so that we can have transparency for the background transition
-        if (surface != NULL && surface->format->format == SDL_PIXELFORMAT_RGB24 && transition) {
-            SDL_Surface *tmp = SDL_CreateRGBSurfaceWithFormat(0,
-                                   surface->w,
-                                   surface->h,
-                                   32,
-                                   SDL_PIXELFORMAT_ARGB8888
-                                );
-            Uint32 color = SDL_MapRGBA(tmp->format, 0, 0, 0, 0xFF);
-            SDL_FillRect(tmp, NULL, color);
-            SDL_BlitSurface(surface, NULL, tmp, NULL);
-            SDL_FreeSurface(surface);
-            surface = tmp;
-            attempts++;
-        } 
-    } while (surface == NULL && slideshow->i != initial_index && attempts < slideshow->num_images);
-    
-    // Switch to color background mode if we failed to load any image from the array
-    if (surface == NULL) {
+        SlideshowImage *image = next_slideshow_image(slideshow->current, &num_images);
+        if (image == NULL || image == slideshow->current)
+            break;
+        probe_slideshow_image(image);
+        bool transpose = image->orientation >= 5;
+        Uint32 start = SDL_GetTicks();
+        surface = load_image(image->path,
+                      transpose ? slideshow->staging->h : slideshow->staging->w,
+                      transpose ? slideshow->staging->w : slideshow->staging->h
+                  );
+        record_slideshow_decode(image, surface, SDL_GetTicks() - start);
+        if (surface != NULL)
+            slideshow->next = image;
+        attempts++;
+    } while (surface == NULL && attempts < 2*num_images);
+    RECORD_DURATION(slideshow_decode, decode_start);
+    TRACE_END(decode_slideshow_background);
+    return surface;
+}
+
+// A function to blend two 32-bit pixels with a weight from 0 to 255 for the
+// second, two channels at a time
+static inline Uint32 lerp_pixel(Uint32 a, Uint32 b, Uint32 weight)
+{
+    Uint32 inverse = 256 - weight;
+    Uint32 rb = (((a & 0x00FF00FF) * inverse + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+    Uint32 ag = (((a >> 8) & 0x00FF00FF) * inverse + ((b >> 8) & 0x00FF00FF) * weight) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// A function to read a pixel of a 24 or 32-bit row in its own channel
+// order, 24-bit pixels are read as if they were ARGB8888 or ABGR8888
+static inline Uint32 read_pixel(const Uint8 *row, int x, int bytes)
+{
+    if (bytes == 3) {
+        const Uint8 *p = row + 3*x;
+        return (Uint32) p[0] << 16 | (Uint32) p[1] << 8 | (Uint32) p[2];
+    }
+    return ((const Uint32*) row)[x];
+}
+
+// A function to find how to read a decoded image without converting it,
+// returns NULL for formats that must be converted first
+static const PixelLayout *get_pixel_layout(Uint32 format)
+{
+    static const PixelLayout layouts[] = {
+        {SDL_PIXELFORMAT_ARGB8888, 4, false, 0},
+        {SDL_PIXELFORMAT_RGB888,   4, false, 0xFF000000},
+        {SDL_PIXELFORMAT_ABGR8888, 4, true,  0},
+        {SDL_PIXELFORMAT_BGR888,   4, true,  0xFF000000},
+        {SDL_PIXELFORMAT_RGB24,    3, false, 0xFF000000},
+        {SDL_PIXELFORMAT_BGR24,    3, true,  0xFF000000}
+    };
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+        if (layouts[i].format == format)
+            return layouts + i;
+    }
+    return NULL;
+}
+
+// A function to stretch a 24 or 32-bit surface over an ARGB8888 or
+// ABGR8888 surface with bilinear filtering, like the renderer stretching the
+// image to the screen would. Pixels are filtered in the source channel order
+// and reordered once per output pixel, so images are never converted.
+// Returns false if the destination could not be written
+static bool scale_surface(SDL_Surface *source, const PixelLayout *layout, SDL_Surface *destination)
+{
+    bool swap = layout->swap != (destination->format->format == SDL_PIXELFORMAT_ABGR8888);
+    Uint32 x_step = ((Uint32) source->w << 16) / (Uint32) destination->w;
+    Uint32 y_step = ((Uint32) source->h << 16) / (Uint32) destination->h;
+
+    // Sample at pixel centers, the offsets and weights of the columns are
+    // the same for every row
+    int *columns = malloc(2 * sizeof(int) * (size_t) destination->w);
+    if (columns == NULL) {
+        log_error("Could not allocate slideshow scaling buffer");
+        return false;
+    }
+    for (int x = 0; x < destination->w; x++) {
+        Sint64 position = (Sint64) x * x_step + x_step / 2 - 0x8000;
+        if (position < 0)
+            position = 0;
+        columns[2*x] = (int) (position >> 16);
+        columns[2*x + 1] = columns[2*x] + 1 < source->w ? (int) ((position >> 8) & 0xFF) : 0;
+    }
+    int bytes = layout->bytes;
+    for (int y = 0; y < destination->h; y++) {
+        Sint64 position = (Sint64) y * y_step + y_step / 2 - 0x8000;
+        if (position < 0)
+            position = 0;
+        int row = (int) (position >> 16);
+        Uint32 y_weight = row + 1 < source->h ? (Uint32) ((position >> 8) & 0xFF) : 0;
+        const Uint8 *top = (const Uint8*) source->pixels + row * source->pitch;
+        const Uint8 *bottom = y_weight ? top + source->pitch : top;
+        Uint32 *out = (Uint32*) ((Uint8*) destination->pixels + y * destination->pitch);
+        for (int x = 0; x < destination->w; x++) {
+            int i = columns[2*x];
+            Uint32 x_weight = (Uint32) columns[2*x + 1];
+            Uint32 upper = read_pixel(top, i, bytes);
+            Uint32 lower = read_pixel(bottom, i, bytes);
+            if (x_weight) {
+                upper = lerp_pixel(upper, read_pixel(top, i + 1, bytes), x_weight);
+                lower = lerp_pixel(lower, read_pixel(bottom, i + 1, bytes), x_weight);
+            }
+            Uint32 pixel = lerp_pixel(upper, lower, y_weight);
+            if (swap)
+                pixel = (pixel & 0xFF00FF00) | (pixel >> 16 & 0xFF) | (pixel & 0xFF) << 16;
+            out[x] = pixel | layout->alpha;
+        }
+    }
+    free(columns);
+    return true;
+}
+
+// A function to copy a 32-bit surface into another, turning it upright
+// for an EXIF orientation. Orientations 5 to 8 transpose the image, so the
+// source is as wide as the destination is high
+static void orient_surface(SDL_Surface *source, SDL_Surface *destination, int orientation)
+{
+    // Step through the source for each step right and down the destination
+    int pitch = source->pitch / 4;
+    int right = source->w - 1;
+    int bottom = (source->h - 1) * pitch;
+    static const int steps[8][2] = {
+        { 1,  1}, {-1,  1}, {-1, -1}, { 1, -1}, // x steps by pixels, y steps by rows
+        { 1,  1}, {-1,  1}, {-1, -1}, { 1, -1}  // x steps by rows, y steps by pixels
+    };
+    const int *step = steps[orientation - 1];
+    int x_step = orientation >= 5 ? step[0] * pitch : step[0];
+    int y_step = orientation >= 5 ? step[1] : step[1] * pitch;
+    int origin = (x_step < 0 ? (orientation >= 5 ? bottom : right) : 0) +
+                 (y_step < 0 ? (orientation >= 5 ? right : bottom) : 0);
+    const Uint32 *pixels = (const Uint32*) source->pixels;
+    for (int y = 0; y < destination->h; y++) {
+        const Uint32 *in = pixels + origin + y * y_step;
+        Uint32 *out = (Uint32*) ((Uint8*) destination->pixels + y * destination->pitch);
+        for (int x = 0; x < destination->w; x++)
+            out[x] = in[x * x_step];
+    }
+}
+
+// A function to scale a decoded slideshow background into the staging frame
+// with the overlay composited in, freeing the surface. Common 24 and 32-bit
+// images are read as decoded, opaque ones need no alpha channel to crossfade
+// because the transition fades the whole texture. This touches no global
+// state, so it can run on a worker thread
+bool stage_slideshow_background(Slideshow *slideshow, SDL_Surface *surface)
+{
+    if (surface == NULL)
+        return false;
+    TRACE_BEGIN(stage_slideshow_background);
+    bool translucent = SDL_ISPIXELFORMAT_ALPHA(surface->format->format) || SDL_HasColorKey(surface);
+    const PixelLayout *layout = SDL_HasColorKey(surface) ? NULL : get_pixel_layout(surface->format->format);
+    if (layout == NULL) {
+        SDL_Surface *tmp = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (tmp == NULL) {
+            log_error("Could not convert slideshow image\n%s", SDL_GetError());
+            TRACE_END(stage_slideshow_background);
+            return false;
+        }
+        surface = tmp;
+        layout = get_pixel_layout(SDL_PIXELFORMAT_ARGB8888);
+    }
+
+    // Scale rotated or mirrored images as stored, then turn the screen
+    // sized result upright
+    SDL_Surface *scaled = NULL;
+    int orientation = slideshow->next != NULL ? slideshow->next->orientation : 1;
+    if (orientation > 1) {
+        bool transpose = orientation >= 5;
+        scaled = SDL_CreateRGBSurfaceWithFormat(0,
+                     transpose ? slideshow->staging->h : slideshow->staging->w,
+                     transpose ? slideshow->staging->w : slideshow->staging->h,
+                     32,
+                     slideshow->staging->format->format
+                 );
+        if (scaled == NULL)
+            log_error("Could not create slideshow orientation frame\n%s", SDL_GetError());
+    }
+    if (SDL_MUSTLOCK(surface))
+        SDL_LockSurface(surface);
+    bool staged = scale_surface(surface, layout, scaled != NULL ? scaled : slideshow->staging);
+    if (SDL_MUSTLOCK(surface))
+        SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    if (!staged) {
+        SDL_FreeSurface(scaled);
+        TRACE_END(stage_slideshow_background);
+        return false;
+    }
+    if (scaled != NULL) {
+        orient_surface(scaled, slideshow->staging, orientation);
+        SDL_FreeSurface(scaled);
+    }
+    if (config.background_overlay)
+        composite_background_overlay(slideshow->staging, translucent);
+    TRACE_END(stage_slideshow_background);
+    return true;
+}
+
+// A function to upload the staging frame into the texture behind the
+// background and return it
+SDL_Texture *upload_slideshow_background(Slideshow *slideshow)
+{
+    SDL_Texture *texture = slideshow->textures[(slideshow->front + 1) % SLIDESHOW_TEXTURES];
+    if (SDL_UpdateTexture(texture, NULL, slideshow->staging->pixels, slideshow->staging->pitch))
+        log_error("Could not update slideshow texture\n%s", SDL_GetError());
+    return texture;
+}
+
+// A function to make the texture behind the background the new background
+void swap_slideshow_textures(Slideshow *slideshow)
+{
+    slideshow->front = (slideshow->front + 1) % SLIDESHOW_TEXTURES;
+    background_texture = slideshow->textures[slideshow->front];
+    slideshow->current = slideshow->next;
+}
+
+// A function to handle the result of decoding a slideshow background on
+// the main thread, returns true if a new background was staged
+bool check_slideshow_background(Slideshow *slideshow, bool staged)
+{
+    // Keep the current background until the scan finds another image
+    if (staged || !slideshow_scanned())
+        return staged;
+
+    // Switch to color background mode if we failed to load any image from the directory
+    if (slideshow->current == NULL) {
         log_error(
             "Could not load any image from slideshow directory %s\n"
             "Changing background to color mode", 
             config.slideshow_directory
         );
+        background_texture = NULL;
         quit_slideshow();
         config.background_mode = BACKGROUND_COLOR;
         set_draw_color();
     }
 
-    // If only one image in the entire slideshow array was valid, switch to
-    // single image background mode
-    else if (slideshow->i == initial_index && surface != NULL) {
+    // If only the current image was valid, switch to single image
+    // background mode, keeping its texture
+    else {
         log_error(
             "Could only load one image from slideshow directory %s\n"
             "Changing background to single image mode",
             config.slideshow_directory
         );
-        background_texture = SDL_CreateTextureFromSurface(renderer, surface);
+        quit_slideshow();
         config.background_mode = BACKGROUND_IMAGE;
     }
-    return surface;
+    return false;
 }
 
-// A function to load a new slideshow background in a separate thread
-int load_next_slideshow_background_async(void *data)
+// A function to load the next slideshow background from the struct into
+// the texture behind the background, returns true if a new background was loaded
+bool load_next_slideshow_background(Slideshow *slideshow)
 {
-    Slideshow *slideshow = (Slideshow*) data;
-    slideshow->transition_surface = load_next_slideshow_background(slideshow, true);
-    state.slideshow_background_rendering = false;
-    state.slideshow_background_ready = true;
-    return 0;
+    bool staged = stage_slideshow_background(slideshow, decode_next_slideshow_background(slideshow));
+    if (!check_slideshow_background(slideshow, staged))
+        return false;
+    upload_slideshow_background(slideshow);
+    return true;
 }
 
 // A function to load a texture from a file
@@ -112,6 +537,7 @@ SDL_Texture *load_texture_from_file(const char *path)
     SDL_Surface *surface = NULL;
     SDL_Texture *texture = NULL;
     if (path != NULL) {
+        TRACE_BEGIN(load_texture_from_file);
         surface = IMG_Load(path);
         if (surface == NULL) {
             log_error(
@@ -122,10 +548,137 @@ SDL_Texture *load_texture_from_file(const char *path)
         }
         else
             texture = load_texture(surface);
+        TRACE_END(load_texture_from_file);
     }
     return texture;
 }
 
+// A function to load a background image texture from a file, with the
+// overlay composited in if enabled
+SDL_Texture *load_background_from_file(const char *path)
+{
+    SDL_Surface *surface = load_image(path, geo.screen_width, geo.screen_height);
+    if (surface == NULL) {
+        log_error("Could not load image %s\n%s", path, IMG_GetError());
+        return NULL;
+    }
+    if (!config.background_overlay)
+        return load_texture(surface);
+    return load_texture(bake_background_overlay(surface));
+}
+
+// A function to flatten translucent background pixels onto the white
+// clear color that is drawn behind background images
+static void flatten_background(SDL_Surface *surface)
+{
+    for (int y = 0; y < surface->h; y++) {
+        Uint32 *pixel = (Uint32*) ((Uint8*) surface->pixels + y * surface->pitch);
+        for (int x = 0; x < surface->w; x++, pixel++) {
+            Uint32 a = *pixel >> 24;
+            if (a == 0xFF)
+                continue;
+            Uint32 out = 0xFF000000;
+            for (int shift = 0; shift < 24; shift += 8) {
+                Uint32 t = ((*pixel >> shift) & 0xFF) * a + 0xFF * (0xFF - a) + 128;
+                out |= ((t + (t >> 8)) >> 8) << shift;
+            }
+            *pixel = out;
+        }
+    }
+}
+
+// A function to blend a constant color over a row of opaque 32-bit pixels,
+// color holds the overlay pixel in memory order
+static void blend_overlay_row(Uint8 *pixels, int width, const Uint8 *color, Uint8 alpha)
+{
+    // Each channel becomes (src*(255 - alpha) + color*alpha)/255, the
+    // division is exact using t = sum + 128, (t + (t >> 8)) >> 8
+    Uint16 inverse = (Uint16) (0xFF - alpha);
+    Uint16 add[8];
+    for (int i = 0; i < 8; i++)
+        add[i] = (Uint16) (color[i % 4] * alpha + 128);
+    int bytes = 4 * width;
+    int i = 0;
+
+#if defined(BLEND_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i inverse_v = _mm_set1_epi16((short) inverse);
+    const __m128i add_v = _mm_loadu_si128((const __m128i*) add);
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i*) (pixels + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), inverse_v), add_v);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), inverse_v), add_v);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        _mm_storeu_si128((__m128i*) (pixels + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(BLEND_NEON)
+    const uint8x8_t inverse_v = vdup_n_u8((uint8_t) inverse);
+    const uint16x8_t add_v = vld1q_u16(add);
+    for (; i + 16 <= bytes; i += 16) {
+        uint8x16_t p = vld1q_u8(pixels + i);
+        uint16x8_t lo = vmlal_u8(add_v, vget_low_u8(p), inverse_v);
+        uint16x8_t hi = vmlal_u8(add_v, vget_high_u8(p), inverse_v);
+        uint8x8_t lo8 = vshrn_n_u16(vsraq_n_u16(lo, lo, 8), 8);
+        uint8x8_t hi8 = vshrn_n_u16(vsraq_n_u16(hi, hi, 8), 8);
+        vst1q_u8(pixels + i, vcombine_u8(lo8, hi8));
+    }
+#endif
+
+    // Remaining pixels, or all of them without SIMD
+    for (; i < bytes; i++) {
+        Uint32 t = (Uint32) pixels[i] * inverse + add[i % 4];
+        pixels[i] = (Uint8) ((t + (t >> 8)) >> 8);
+    }
+}
+
+// A function to composite the background overlay into a decoded background
+// image once, so frames draw a single full screen layer. The result is an
+// opaque surface in the texture format. This touches no global state other
+// than the format, so it can run on a worker thread
+SDL_Surface *bake_background_overlay(SDL_Surface *surface)
+{
+    if (surface == NULL)
+        return NULL;
+    bool translucent = SDL_ISPIXELFORMAT_ALPHA(surface->format->format) || SDL_HasColorKey(surface);
+    SDL_Surface *output = surface;
+    if (surface->format->format != texture_format) {
+        output = SDL_ConvertSurfaceFormat(surface, texture_format, 0);
+        SDL_FreeSurface(surface);
+        if (output == NULL) {
+            log_error("Could not convert background image\n%s", SDL_GetError());
+            return NULL;
+        }
+    }
+    composite_background_overlay(output, translucent);
+    return output;
+}
+
+// A function to composite the background overlay into an ARGB8888 or
+// ABGR8888 surface in place, flattening it first if the image it came from was translucent
+static void composite_background_overlay(SDL_Surface *surface, bool translucent)
+{
+    if (translucent)
+        flatten_background(surface);
+
+    // Get the overlay color in the memory order of the pixels
+    Uint32 color = SDL_MapRGBA(surface->format,
+                       config.background_overlay_color.r,
+                       config.background_overlay_color.g,
+                       config.background_overlay_color.b,
+                       0xFF
+                   );
+    Uint8 color_bytes[4];
+    memcpy(color_bytes, &color, sizeof(color_bytes));
+    for (int y = 0; y < surface->h; y++) {
+        blend_overlay_row((Uint8*) surface->pixels + y * surface->pitch,
+            surface->w,
+            color_bytes,
+            config.background_overlay_color.a
+        );
+    }
+}
+
 // A function to load a texture from a    SDL surface
 SDL_Texture *load_texture(SDL_Surface *surface)
 {
@@ -141,15 +694,24 @@ SDL_Texture *load_texture(SDL_Surface *surface)
     return texture;
 }
 
-// A function to rasterize an SVG from an existing text buffer
-SDL_Texture *rasterize_svg(char *buffer, int w, int h, SDL_Rect *rect)
+// A function to rasterize an SVG from an existing text buffer into RGBA
+// pixels, safe to call from any thread
+unsigned char *rasterize_svg_pixels(char *buffer, int w, int h, int *width, int *height)
 {
     NSVGimage *image = NULL;
     unsigned char *pixel_buffer = NULL;
-    int width, height, pitch;
     float scale;
+    float tx = 0.0f;
+    float ty = 0.0f;
+
+    NSVGrasterizer *rasterizer = get_rasterizer();
+    if (rasterizer == NULL) {
+        log_error("Could not create SVG rasterizer.");
+        return NULL;
+    }
 
     // Parse SVG to NSVGimage struct
+    TRACE_BEGIN(rasterize_svg);
     image = nsvgParse(buffer, "px", 96.0f);
     if (image == NULL) {
         log_error("could not open SVG image.");
@@ -159,53 +721,453 @@ SDL_Texture *rasterize_svg(char *buffer, int w, int h, SDL_Rect *rect)
     // Calculate scaling and dimensions
     if (w == -1 && h == -1) {
         scale = 1.0f;
-        width = (int) image->width;
-        height = (int) image->height;
+        *width = (int) image->width;
+        *height = (int) image->height;
     }
     else if (w == -1 && h != -1) {
         scale = (float) h / (float) image->height;
-        width = (int) ceil((double) image->width * (double) scale);
-        height = h;
+        *width = (int) ceil((double) image->width * (double) scale);
+        *height = h;
     }
     else if (w != -1 && h == -1) {
         scale = (float) w / (float) image->width;
-        width = w;
-        height = (int) ceil((double) image->height * (double) scale);
+        *width = w;
+        *height = (int) ceil((double) image->height * (double) scale);
     }
+
+    // Fit the image inside the box and center it
     else {
-        scale = (float) w / (float) image->width;
-        width = w;
-        height = h;
+        scale = fminf((float) w / (float) image->width, (float) h / (float) image->height);
+        *width = w;
+        *height = h;
+        tx = ((float) w - image->width * scale) / 2.0f;
+        ty = ((float) h - image->height * scale) / 2.0f;
     }
     
     // Allocate memory
-    pitch = 4*width;
-    pixel_buffer = malloc((size_t) (4*width*height));
+    pixel_buffer = calloc((size_t) (*width * *height), 4);
     if (pixel_buffer == NULL) {
         log_error("Could not alloc SVG pixel buffer.");
+        nsvgDelete(image);
         return NULL;
     }
 
     // Rasterize image
-    nsvgRasterize(rasterizer, image, 0, 0, scale, pixel_buffer, width, height, pitch);
-    SDL_Surface *surface = SDL_CreateRGBSurfaceFrom(pixel_buffer,
-                               width,
-                               height,
-                               32,
-                               pitch,
-                               COLOR_MASKS
-                           );
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    nsvgRasterize(rasterizer, image, tx, ty, scale, pixel_buffer, *width, *height, 4 * *width);
+    nsvgDelete(image);
+    TRACE_END(rasterize_svg);
+    return pixel_buffer;
+}
+
+// A function to pick the texture format the renderer uploads without
+// converting, out of the 32-bit formats images are converted to on workers
+Uint32 get_preferred_texture_format(SDL_Renderer *renderer)
+{
+    SDL_RendererInfo info;
+    if (!SDL_GetRendererInfo(renderer, &info)) {
+        for (Uint32 i = 0; i < info.num_texture_formats; i++) {
+            if (info.texture_formats[i] == SDL_PIXELFORMAT_ARGB8888 ||
+            info.texture_formats[i] == SDL_PIXELFORMAT_ABGR8888)
+                return info.texture_formats[i];
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+// A function to swap the red and blue bytes of 32-bit pixels in place,
+// converting between RGBA and BGRA byte order
+static void swizzle_pixels(Uint8 *pixels, size_t count)
+{
+    size_t i = 0;
+
+#if defined(BLEND_SSE2)
+    const __m128i mask_ag = _mm_set1_epi32((int) 0xFF00FF00);
+    const __m128i mask_low = _mm_set1_epi32(0xFF);
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*) (pixels + 4*i));
+        __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), mask_low);
+        __m128i b = _mm_slli_epi32(_mm_and_si128(p, mask_low), 16);
+        p = _mm_or_si128(_mm_and_si128(p, mask_ag), _mm_or_si128(r, b));
+        _mm_storeu_si128((__m128i*) (pixels + 4*i), p);
+    }
+#elif defined(BLEND_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t p = vld4q_u8(pixels + 4*i);
+        uint8x16_t tmp = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = tmp;
+        vst4q_u8(pixels + 4*i, p);
+    }
+#endif
+
+    // Remaining pixels, or all of them without SIMD
+    for (; i < count; i++) {
+        Uint8 tmp = pixels[4*i];
+        pixels[4*i] = pixels[4*i + 2];
+        pixels[4*i + 2] = tmp;
+    }
+}
+
+// A function to convert a decoded image to the texture format, this touches
+// no global state other than the format so it can run on a worker thread.
+// Pixels in the other byte order are swizzled in place, the format of the
+// pixels is returned
+static SDL_Surface *convert_to_texture_format(SDL_Surface *surface, Uint32 *format)
+{
+    *format = surface->format->format;
+    if (*format == texture_format)
+        return surface;
+    bool swizzle = !SDL_HasColorKey(surface) && !SDL_MUSTLOCK(surface) &&
+                   ((*format == SDL_PIXELFORMAT_RGBA32 && texture_format == SDL_PIXELFORMAT_BGRA32) ||
+                   (*format == SDL_PIXELFORMAT_BGRA32 && texture_format == SDL_PIXELFORMAT_RGBA32));
+    if (swizzle) {
+        for (int y = 0; y < surface->h; y++)
+            swizzle_pixels((Uint8*) surface->pixels + y * surface->pitch, (size_t) surface->w);
+        *format = texture_format;
+        return surface;
+    }
+    SDL_Surface *output = SDL_ConvertSurfaceFormat(surface, texture_format, 0);
+    SDL_FreeSurface(surface);
+    if (output != NULL)
+        *format = texture_format;
+    else
+        log_error("Could not convert image\n%s", SDL_GetError());
+    return output;
+}
+
+// A function to create a texture from pixels already in a format the
+// renderer supports, so the upload is a plain copy
+static SDL_Texture *create_texture(const void *pixels, int pitch, Uint32 format, int width, int height)
+{
+    SDL_Texture *texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, width, height);
+    if (texture == NULL) {
+        log_error("Could not create texture %s", SDL_GetError());
+        return NULL;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    if (SDL_UpdateTexture(texture, NULL, pixels, pitch))
+        log_error("Could not update texture %s", SDL_GetError());
+    return texture;
+}
+
+// A function to convert RGBA pixels to the texture format in place if it
+// only differs in byte order, returns the format of the pixels
+static Uint32 convert_pixels(unsigned char *pixels, int width, int height)
+{
+    if (texture_format != SDL_PIXELFORMAT_BGRA32)
+        return SDL_PIXELFORMAT_RGBA32;
+    swizzle_pixels(pixels, (size_t) width * (size_t) height);
+    return SDL_PIXELFORMAT_BGRA32;
+}
+
+// A function to create a texture from RGBA pixels, which are converted in place
+SDL_Texture *load_texture_from_pixels(unsigned char *pixels, int width, int height)
+{
+    Uint32 format = convert_pixels(pixels, width, height);
+    return create_texture(pixels, 4*width, format, width, height);
+}
+
+// A function to get the approximate GPU memory used by a texture
+size_t get_texture_bytes(SDL_Texture *texture)
+{
+    Uint32 format;
+    int w, h;
+    if (texture == NULL || SDL_QueryTexture(texture, &format, NULL, &w, &h))
+        return 0;
+    return (size_t) w * (size_t) h * SDL_BYTESPERPIXEL(format);
+}
+
+// A function to rasterize an SVG from an existing text buffer
+SDL_Texture *rasterize_svg(char *buffer, int w, int h, SDL_Rect *rect)
+{
+    int width, height;
+    unsigned char *pixels = rasterize_svg_pixels(buffer, w, h, &width, &height);
+    if (pixels == NULL)
+        return NULL;
+    SDL_Texture *texture = load_texture_from_pixels(pixels, width, height);
     if (rect != NULL) {
         rect->w = width;
         rect->h = height;
     }
-    free(pixel_buffer);
-    SDL_FreeSurface(surface);
-    nsvgDelete(image);
+    free(pixels);
     return texture;
 }
 
+// A function to calculate the 64-bit FNV-1a hash of a buffer
+static Uint64 hash_buffer(const char *buffer, size_t size)
+{
+    Uint64 hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (Uint8) buffer[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// A function to read an SVG file into a null-terminated buffer
+static char *read_svg_file(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    char *buffer = NULL;
+    if (!fseek(file, 0, SEEK_END)) {
+        long length = ftell(file);
+        if (length > 0 && !fseek(file, 0, SEEK_SET)) {
+            buffer = malloc((size_t) length + 1);
+            *size = fread(buffer, 1, (size_t) length, file);
+            buffer[*size] = '\0';
+        }
+    }
+    fclose(file);
+    return buffer;
+}
+
+// A function to read a cached SVG bitmap, returns NULL if missing or invalid
+static unsigned char *read_svg_cache(const char *cache_path, int *width, int *height)
+{
+    FILE *file = fopen(cache_path, "rb");
+    if (file == NULL)
+        return NULL;
+    SVGCacheHeader header;
+    unsigned char *pixels = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+    header.magic == SVG_CACHE_MAGIC &&
+    header.version == SVG_CACHE_VERSION &&
+    header.width > 0 && header.width <= MAX_SVG_CACHE_SIZE &&
+    header.height > 0 && header.height <= MAX_SVG_CACHE_SIZE) {
+        size_t bytes = 4 * (size_t) header.width * (size_t) header.height;
+        pixels = malloc(bytes);
+        if (fread(pixels, 1, bytes, file) == bytes) {
+            *width = (int) header.width;
+            *height = (int) header.height;
+        }
+        else {
+            free(pixels);
+            pixels = NULL;
+        }
+    }
+    fclose(file);
+
+    // Mark the bitmap as recently used so pruning keeps it
+    if (pixels != NULL)
+        touch_file(cache_path);
+    return pixels;
+}
+
+// A function to write a rasterized SVG bitmap to the cache
+static void write_svg_cache(const char *cache_path, unsigned char *pixels, int width, int height)
+{
+    // Write to a file unique to this thread first so that concurrent
+    // writers and crashes never leave a partial cache file behind
+    char tmp_path[MAX_PATH_CHARS + 1];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lu.tmp", cache_path, (unsigned long) SDL_ThreadID());
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+        return;
+    SVGCacheHeader header = {
+        .magic = SVG_CACHE_MAGIC,
+        .version = SVG_CACHE_VERSION,
+        .width = (Uint32) width,
+        .height = (Uint32) height
+    };
+    size_t bytes = 4 * (size_t) width * (size_t) height;
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(pixels, 1, bytes, file) == bytes;
+    success = !fclose(file) && success;
+    if (!success || rename(tmp_path, cache_path))
+        remove(tmp_path);
+}
+
+// A function to add a file found in the cache directory to the list
+static void add_svg_cache_file(const char *path, Sint64 size, Sint64 mtime)
+{
+    if (cache_list.num_files == cache_list.capacity) {
+        int capacity = cache_list.capacity ? 2 * cache_list.capacity : SVG_CACHE_MIN_FILES;
+        SVGCacheFile *files = realloc(cache_list.files, (size_t) capacity * sizeof(SVGCacheFile));
+        if (files == NULL)
+            return;
+        cache_list.files = files;
+        cache_list.capacity = capacity;
+    }
+    char *copy = strdup(path);
+    if (copy == NULL)
+        return;
+    cache_list.files[cache_list.num_files++] = (SVGCacheFile) {
+        .path = copy,
+        .size = size,
+        .mtime = mtime
+    };
+    cache_list.total_bytes += size;
+}
+
+// A function to order cache files from least to most recently used
+static int compare_svg_cache_files(const void *a, const void *b)
+{
+    Sint64 first = ((const SVGCacheFile*) a)->mtime;
+    Sint64 second = ((const SVGCacheFile*) b)->mtime;
+    return (first > second) - (first < second);
+}
+
+// A function to remove the least recently used SVG bitmaps until the cache
+// fits in its size limit, bitmaps of old icon sizes and themes age out
+static void prune_svg_cache()
+{
+    scan_cache_directory(cache_directory, SVG_CACHE_EXTENSION, add_svg_cache_file);
+    if (cache_list.total_bytes > MAX_SVG_CACHE_BYTES) {
+        qsort(cache_list.files, (size_t) cache_list.num_files, sizeof(SVGCacheFile), compare_svg_cache_files);
+        int removed = 0;
+        for (int i = 0; i < cache_list.num_files && cache_list.total_bytes > MAX_SVG_CACHE_BYTES; i++) {
+            if (!remove(cache_list.files[i].path)) {
+                cache_list.total_bytes -= cache_list.files[i].size;
+                removed++;
+            }
+        }
+        log_debug("Removed %i SVG bitmaps from the cache", removed);
+    }
+    for (int i = 0; i < cache_list.num_files; i++)
+        free(cache_list.files[i].path);
+    free(cache_list.files);
+    cache_list = (SVGCacheList) {0};
+}
+
+// A function to load an SVG file as RGBA pixels at a given size, using
+// the on-disk cache if possible. Safe to call from any thread.
+unsigned char *load_svg_pixels(const char *path, int w, int h, int *width, int *height)
+{
+    size_t size = 0;
+    char *buffer = read_svg_file(path, &size);
+    if (buffer == NULL) {
+        log_error("Could not read SVG file %s", path);
+        return NULL;
+    }
+
+    // Look up the bitmap by file contents and target size
+    char cache_path[MAX_PATH_CHARS + 1];
+    unsigned char *pixels = NULL;
+    if (cache_enabled) {
+        Uint64 hash = hash_buffer(buffer, size);
+        char filename[MAX_SVG_CACHE_FILENAME_CHARS + 1];
+        snprintf(filename,
+            sizeof(filename),
+            SVG_CACHE_FILENAME_FORMAT,
+            (unsigned long) (hash >> 32),
+            (unsigned long) (hash & 0xFFFFFFFF),
+            w,
+            h
+        );
+        join_paths(cache_path, sizeof(cache_path), 2, cache_directory, filename);
+        pixels = read_svg_cache(cache_path, width, height);
+    }
+
+    // Rasterize and store the result on a cache miss
+    if (pixels == NULL) {
+        pixels = rasterize_svg_pixels(buffer, w, h, width, height);
+        if (pixels != NULL && cache_enabled)
+            write_svg_cache(cache_path, pixels, *width, *height);
+    }
+    free(buffer);
+    return pixels;
+}
+
+// A function to rasterize an SVG file into a texture
+SDL_Texture *rasterize_svg_from_file(const char *path, int w, int h, SDL_Rect *rect)
+{
+    int width, height;
+    unsigned char *pixels = load_svg_pixels(path, w, h, &width, &height);
+    if (pixels == NULL)
+        return NULL;
+    SDL_Texture *texture = load_texture_from_pixels(pixels, width, height);
+    if (rect != NULL) {
+        rect->w = width;
+        rect->h = height;
+    }
+    free(pixels);
+    return texture;
+}
+
+// A function to decode or rasterize an icon into the texture format on a
+// worker thread
+static void rasterize_icon(void *data)
+{
+    IconJob *job = (IconJob*) data;
+    if (!job->svg) {
+        job->surface = IMG_Load(job->path);
+        if (job->surface == NULL)
+            log_error("Could not load image %s\n%s", job->path, IMG_GetError());
+        else
+            job->surface = convert_to_texture_format(job->surface, &job->format);
+        return;
+    }
+    job->pixels = load_svg_pixels(job->path, job->size, job->size, &job->width, &job->height);
+    if (job->pixels != NULL)
+        job->format = convert_pixels(job->pixels, job->width, job->height);
+}
+
+// A function to upload the pixels of an icon to its texture on the main thread
+static void finish_icon(void *data)
+{
+    IconJob *job = (IconJob*) data;
+    if (job->pixels != NULL) {
+        *job->texture = create_texture(job->pixels, 4*job->width, job->format, job->width, job->height);
+        free(job->pixels);
+    }
+    else if (job->surface != NULL) {
+        *job->texture = create_texture(job->surface->pixels,
+                            job->surface->pitch,
+                            job->format,
+                            job->surface->w,
+                            job->surface->h
+                        );
+        SDL_FreeSurface(job->surface);
+    }
+    if (job->pending != NULL && !--(*job->pending))
+        state.icons_loaded = true;
+    free(job);
+}
+
+// A function to load an icon, icons are decoded into the texture format
+// on a worker thread, SVG icons at the icon size, and the texture is set
+// when the job completes. The optional pending counter is held up until then
+void load_icon(const char *path, SDL_Texture **texture, unsigned int *pending)
+{
+    *texture = NULL;
+    if (path == NULL)
+        return;
+    size_t length = strlen(path);
+    IconJob *job = malloc(sizeof(IconJob));
+    *job = (IconJob) {
+        .path = (char*) path,
+        .svg = length >= strlen(EXT_SVG) && !SDL_strcasecmp(path + length - strlen(EXT_SVG), EXT_SVG),
+        .size = config.icon_size,
+        .pixels = NULL,
+        .surface = NULL,
+        .texture = texture,
+        .pending = pending
+    };
+    if (pending != NULL)
+        (*pending)++;
+    if (!submit_job(rasterize_icon, finish_icon, job)) {
+        rasterize_icon(job);
+        finish_icon(job);
+    }
+}
+
+// A function to blend a single color over the whole screen without a backing texture
+void draw_color_layer(SDL_Color *color, Uint8 alpha)
+{
+    if (!alpha)
+        return;
+
+    // The draw color is also the clear color, so restore it afterwards
+    Uint8 r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_SetRenderDrawBlendMode(renderer, alpha == 0xFF ? SDL_BLENDMODE_NONE : SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, color->r, color->g, color->b, alpha);
+    SDL_RenderFillRect(renderer, NULL);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
 // A function to render the highlight for the buttons
 SDL_Texture *render_highlight(int width, int height, SDL_Rect *rect)
 {
@@ -280,112 +1242,10 @@ void render_scroll_indicators(Scroll *scroll, int height, Geometry *geo)
     scroll->rect_left.x = geo->screen_margin;
 }
 
-// A function to render text
-SDL_Surface *render_text(const char *text, TextInfo *info, SDL_Rect *rect, int *text_height)
-{
-    TTF_Font *output_font = NULL;
-    TTF_Font *reduced_font = NULL; // Font for Shrink text oversize mode
-    int w, h;
-
-    // Copy text into new buffer in case we need to manipulate it
-    char *text_buffer = strdup(text);
-
-    // Calculate size of the rendered title
-    TTF_SizeUTF8(info->font, text_buffer, &w, &h);
-
-    // If title is too large to fit
-    if (info->oversize_mode != OVERSIZE_NONE && w > info->max_width) {
-
-        // Truncate mode:
-        if (info->oversize_mode == OVERSIZE_TRUNCATE) {
-            utf8_truncate(text_buffer, w, info->max_width);
-            TTF_SizeUTF8(info->font, text_buffer, &w, &h);
-        }
-
-        // Shrink mode:
-        else if (info->oversize_mode == OVERSIZE_SHRINK) {
-            int reduced_font_size = (int) info->font_size - 1;
-            reduced_font = TTF_OpenFont(*info->font_path, reduced_font_size);
-            TTF_SizeUTF8(reduced_font, text_buffer, &w, &h);
-
-            // Keep trying smaller font until it fits
-            while (w > info->max_width && reduced_font_size > 0) {
-                TTF_CloseFont(reduced_font);
-                reduced_font = NULL;
-                reduced_font_size--;
-                reduced_font = TTF_OpenFont(*info->font_path, reduced_font_size);
-                TTF_SizeUTF8(reduced_font, text_buffer, &w, &h);
-            }
-
-            if (reduced_font_size)
-                output_font = reduced_font;
-            else
-                reduced_font = NULL;
-        }
-    }
-    if (reduced_font == NULL)
-        output_font = info->font;
-
-    // Render surface
-    SDL_Surface *surface = NULL;
-    if (info->shadow) {
-        int shadow_offset = h / 40;
-        if (shadow_offset < 2)
-            shadow_offset = 2;
-        SDL_Surface *foreground = TTF_RenderUTF8_Blended(output_font,
-                                      text_buffer,
-                                      *info->color
-                                  );
-        SDL_Surface *shadow = TTF_RenderUTF8_Blended(output_font, 
-                                  text_buffer, 
-                                  *info->shadow_color
-                              );
-        surface = SDL_CreateRGBSurfaceWithFormat(0, 
-                      foreground->w + shadow_offset, 
-                      foreground->h + shadow_offset, 
-                      32,
-                      SDL_PIXELFORMAT_ARGB8888
-                  );
-        Uint32 color = SDL_MapRGBA(surface->format, 0, 0, 0, 0);
-        SDL_FillRect(surface, NULL, color);
-        SDL_Rect shadow_rect = {shadow_offset, shadow_offset, shadow->w, shadow->h};
-        SDL_BlitSurface(shadow, NULL, surface, &shadow_rect);
-        SDL_Rect rect = {0, 0, foreground->w, foreground->h};
-        SDL_BlitSurface(foreground, NULL, surface, &rect);
-        SDL_FreeSurface(foreground);
-        SDL_FreeSurface(shadow);
-    }
-    else
-        surface = TTF_RenderUTF8_Blended(output_font,
-                      text_buffer,
-                      *info->color
-                  );
-
-    // Set geometry
-    rect->w = surface->w;
-    rect->h = surface->h;
-    if (info->oversize_mode == OVERSIZE_SHRINK && text_height != NULL)
-        *text_height = h;
-
-    // Clean up
-    if (reduced_font != NULL)
-        TTF_CloseFont(reduced_font);
-    free(text_buffer);
-    
-    return surface;
-}
-
-// A function to render text into a texture
-SDL_Texture *render_text_texture(const char *text, TextInfo *info, SDL_Rect *rect, int *text_height)
-{
-    SDL_Surface *surface = render_text(text, info, rect, text_height);
-    return load_texture(surface);
-}
-
 // A function to load a font from a file
 int load_font(TextInfo *info, const char *default_font)
 {
-    char *font_path = *info->font_path;
+    const char *font_path = *info->font_path;
     // Load user specified font
     if (font_path != NULL)
         info->font = TTF_OpenFont(font_path, info->font_size);
@@ -406,8 +1266,7 @@ int load_font(TextInfo *info, const char *default_font)
         // Replace user font with default in config
         if (default_font_path != NULL) {
             info->font = TTF_OpenFont(default_font_path, info->font_size);
-            free(font_path);
-            *(info->font_path) = strdup(default_font_path);
+            *(info->font_path) = intern_string(&config_arena, default_font_path);
             free(default_font_path);
         }
         if (info->font == NULL) {
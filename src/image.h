@@ -3,6 +3,26 @@
 #define HIGHLIGHT_FORMAT "<svg viewBox=\"0 0 %i %i\"><rect x=\"0\" width=\"%i\" height=\"%i\" rx=\"%i\" fill=\"#%02X%02X%02X\" fill-opacity=\"%.2f\"%s/></svg>"
 #define SCROLL_INDICATOR_FORMAT "<svg width=\"195\" height=\"300\" viewBox=\"0 0 195 300\" version=\"1.1\" id=\"SVGRoot\" > <defs id=\"defs889\"/> <g id=\"layer1\" transform=\"translate(-105)\"> <path style=\"fill:#%02X%02X%02X;fill-opacity:%.2f;stroke:#%02X%02X%02X;stroke-width:%i;stroke-linecap:butt;stroke-linejoin:miter;stroke-miterlimit:4;stroke-dasharray:none;stroke-opacity:%.2f\" d=\"M 280,150 150,280 125,255 C 170,210 230.69212,149.36112 230,150 L 125,45 150,20 Z\" id=\"path3884\"/> </g></svg>"
 #define SHADOW_OPACITY_MULTIPLIER 0.75F
+#define EXT_SVG ".svg"
+
+// SIMD paths for compositing the background overlay
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLEND_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BLEND_NEON
+#endif
+
+// SVG bitmap cache
+#define SVG_CACHE_MAGIC 0x43475653 // "SVGC"
+#define SVG_CACHE_VERSION 1
+#define MAX_SVG_CACHE_SIZE 4096
+#define SVG_CACHE_EXTENSION ".rgba"
+#define SVG_CACHE_FILENAME_FORMAT "%08lx%08lx_%ix%i" SVG_CACHE_EXTENSION
+#define MAX_SVG_CACHE_BYTES (64 * BYTES_PER_MEGABYTE) // Least recently used bitmaps are removed above this at startup
+#define SVG_CACHE_MIN_FILES 64
+#define MAX_SVG_CACHE_FILENAME_CHARS 48
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
 
 // Macro functions
 #define format_highlight_outline(buffer, outline_size, outline_color, outline_opacity) sprintf_alloc(buffer, HIGHLIGHT_OUTLINE_FORMAT, outline_size, outline_color.r, outline_color.g, outline_color.b, outline_opacity)
@@ -21,16 +41,73 @@ typedef struct {
     ModeOversize oversize_mode;
 } TextInfo;
 
+// Header of a cached SVG bitmap, followed by width*height RGBA pixels
+typedef struct {
+    Uint32 magic;
+    Uint32 version;
+    Uint32 width;
+    Uint32 height;
+} SVGCacheHeader;
+
+// File of the SVG bitmap cache, listed at startup to enforce its size limit
+typedef struct {
+    char   *path;
+    Sint64 size;
+    Sint64 mtime; // Refreshed whenever the bitmap is read
+} SVGCacheFile;
+
+// Files of the SVG bitmap cache
+typedef struct {
+    SVGCacheFile *files;
+    int          num_files;
+    int          capacity;
+    Sint64       total_bytes;
+} SVGCacheList;
+
+// Channel layout of a decoded image the slideshow scaler reads directly
+typedef struct {
+    Uint32 format;
+    int    bytes; // Bytes per pixel
+    bool   swap; // Red and blue are swapped relative to ARGB8888
+    Uint32 alpha; // Alpha bits to set for formats without alpha
+} PixelLayout;
+
+// Icon decoded on a worker thread
+typedef struct {
+    char *path;
+    bool svg;
+    int size;
+    unsigned char *pixels; // Rasterized SVG
+    SDL_Surface *surface; // Decoded image
+    Uint32 format; // Format of the pixels or surface
+    int width;
+    int height;
+    SDL_Texture **texture;
+    unsigned int *pending;
+} IconJob;
+
 int init_svg(void);
 int load_font(TextInfo *info, const char *default_font);
 void quit_svg(void);
 void render_scroll_indicators(Scroll *scroll, int height, Geometry *geo);
-SDL_Surface *load_next_slideshow_background(Slideshow *slideshow, bool transition);
-int load_next_slideshow_background_async(void *data);
+bool create_slideshow_textures(Slideshow *slideshow, int width, int height);
+bool load_next_slideshow_background(Slideshow *slideshow);
+SDL_Surface *decode_next_slideshow_background(Slideshow *slideshow);
+bool stage_slideshow_background(Slideshow *slideshow, SDL_Surface *surface);
+SDL_Texture *upload_slideshow_background(Slideshow *slideshow);
+void swap_slideshow_textures(Slideshow *slideshow);
+bool check_slideshow_background(Slideshow *slideshow, bool staged);
 SDL_Texture *load_texture(SDL_Surface *surface);
 SDL_Texture *load_texture_from_file(const char *path);
+SDL_Texture *load_background_from_file(const char *path);
+SDL_Surface *bake_background_overlay(SDL_Surface *surface);
+SDL_Texture *load_texture_from_pixels(unsigned char *pixels, int width, int height);
+void load_icon(const char *path, SDL_Texture **texture, unsigned int *pending);
+size_t get_texture_bytes(SDL_Texture *texture);
+Uint32 get_preferred_texture_format(SDL_Renderer *renderer);
+unsigned char *rasterize_svg_pixels(char *buffer, int w, int h, int *width, int *height);
+unsigned char *load_svg_pixels(const char *path, int w, int h, int *width, int *height);
 SDL_Texture *rasterize_svg(char *buffer, int w, int h, SDL_Rect *rect);
 SDL_Texture *rasterize_svg_from_file(const char *path, int w, int h, SDL_Rect *rect);
 SDL_Texture *render_highlight(int width, int height, SDL_Rect *rect);
-SDL_Surface *render_text(const char *text, TextInfo *info, SDL_Rect *rect, int *text_height);
-SDL_Texture *render_text_texture(const char *text, TextInfo *info, SDL_Rect *rect, int *text_height);
+void draw_color_layer(SDL_Color *color, Uint8 alpha);
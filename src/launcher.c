@@ -14,7 +14,18 @@
 #include "util.h"
 #include "debug.h"
 #include "clock.h"
+#include "text.h"
+#include "worker.h"
+#include "trace.h"
+#include "arena.h"
+#include "scanner.h"
+#include "animation.h"
+#include "metrics.h"
+#include "search.h"
 #include "platform/platform.h"
+#ifdef __unix__
+#include "control.h"
+#endif
 
 static void init_sdl(void);
 static void init_sdl_image(void);
@@ -23,20 +34,56 @@ static void init_sdl_ttf(void);
 static int load_menu(Menu *menu, bool set_back_menu, bool reset_position);
 static int load_menu_by_name(const char *menu_name, bool set_back_menu, bool reset_position);
 static void update_slideshow(void);
+static void decode_slideshow_background(void *data);
+static void finish_slideshow_background(void *data);
+static void finish_slideshow_transition(void *data);
+static void finish_screensaver_transition(void *data);
 static void resume_slideshow(void);
 static void update_screensaver(void);
-static void update_clock(bool block);
+static void update_clock(void);
+static void schedule_wakeup(Uint32 deadline);
+static bool is_idle(void);
+static void wait_for_wakeup(void);
 static void init_slideshow(void);
+static void check_slideshow_images(void);
 static void init_screensaver(void);
 static void calculate_button_geometry(Entry *entry, int buttons);
+static void render_button(Entry *entry, unsigned int *pending);
 static void render_buttons(Menu *menu);
+static bool is_virtual_grid(Menu *menu);
+static Entry *get_grid_entry(Menu *menu, unsigned int index);
+static void render_grid_rows(Menu *menu);
+static void unload_button(Entry *entry);
+static void unload_buttons(Menu *menu);
+static void enforce_texture_budget(void);
+static void move_highlight(Uint32 duration);
+static Uint32 get_highlight_transition_time(void);
+static void slide_page(Entry *previous_root, int previous_buttons, int direction);
+static void finish_page_slide(void *data);
+static void draw_buttons(Entry *entry, int buttons, int offset, int highlight_position);
 static void move_left(void);
 static void move_right(void);
+static void move_up(void);
+static void move_down(void);
+static void move_grid(int step);
 static void load_submenu(const char *submenu);
 static void load_back_menu(Menu *menu);
 static void draw_screen(void);
 static void handle_keypress(SDL_Keysym *key);
-static void execute_command(const char *command);
+static void start_search(void);
+static void update_search(void);
+static void layout_search_prompt(void);
+static void clear_search_slot(SearchSlot *slot);
+static SearchSlot *get_search_slot(Entry *source);
+static void add_search_text(const char *text);
+static void handle_search_keypress(SDL_Keysym *key);
+static void select_search_result(Entry *result);
+static void end_search(void);
+static void execute_command(const char *command, Entry *entry);
+#ifdef __unix__
+static bool is_control_command(const char *command);
+static void handle_control_request(ControlRequest *request);
+#endif
 static void poll_gamepad(void);
 static void init_gamepad(Gamepad **gamepad, int device_index);
 static void connect_gamepad(int device_index, bool open, bool raise_error);
@@ -53,6 +100,7 @@ Config config = {
     .vsync                            = true,
     .fps_limit                        = -1,
     .application_timeout              = DEFAULT_APPLICATION_TIMEOUT * 1000,
+    .texture_memory_limit             = DEFAULT_TEXTURE_MEMORY_LIMIT * BYTES_PER_MEGABYTE,
     .titles_enabled                   = DEFAULT_TITLES_ENABLED,
     .title_font_size                  = DEFAULT_FONT_SIZE,
     .title_font_color.r               = DEFAULT_TITLE_FONT_COLOR_R,
@@ -93,6 +141,7 @@ Config config = {
     .highlight_rx                     = DEFAULT_HIGHLIGHT_CORNER_RADIUS,
     .title_padding                    = -1,
     .max_buttons                      = DEFAULT_MAX_BUTTONS,
+    .rows                             = DEFAULT_ROWS,
     .icon_spacing                     = -1,
     .highlight_vpadding               = -1,
     .highlight_hpadding               = -1,
@@ -114,11 +163,14 @@ Config config = {
     .scroll_indicator_opacity[0]      = '\0',
     .title_oversize_mode              = OVERSIZE_TRUNCATE,
     .wrap_entries                     = DEFAULT_WRAP_ENTRIES,
+    .animated_navigation              = DEFAULT_ANIMATED_NAVIGATION,
     .reset_on_back                    = DEFAULT_RESET_ON_BACK,
     .mouse_select                     = DEFAULT_MOUSE_SELECT,
     .inhibit_os_screensaver           = DEFAULT_INHIBIT_OS_SCREENSAVER,
     .startup_cmd                      = NULL,
     .quit_cmd                         = NULL,
+    .control_socket                   = NULL,
+    .metrics_file                     = NULL,
     .screensaver_enabled              = false,
     .screensaver_idle_time            = DEFAULT_SCREENSAVER_IDLE_TIME*1000,
     .screensaver_intensity_str[0]     = '\0',
@@ -162,10 +214,11 @@ State state = { false };
 SDL_Window *window                    = NULL;
 SDL_Renderer *renderer                = NULL;
 SDL_Texture *background_texture       = NULL;
-SDL_Texture *background_overlay       = NULL;
+Uint32 texture_format                 = SDL_PIXELFORMAT_ARGB8888;
 Menu *default_menu                    = NULL;
 Menu *current_menu                    = NULL;
 Entry *current_entry                  = NULL;
+Entry *launched_entry                 = NULL;
 Highlight *highlight                  = NULL;
 Scroll *scroll                        = NULL;
 Slideshow *slideshow                  = NULL;
@@ -174,14 +227,18 @@ FILE *log_file                        = NULL;
 Gamepad *gamepads                     = NULL;
 GamepadControl *gamepad_controls      = NULL;
 Hotkey *hotkeys                       = NULL;
+Arena config_arena                    = {0}; // Holds everything parsed from the config file
+unsigned int menu_visits              = 0;
+PageSlide page_slide                  = {0};
 Clock *clk                            = NULL;
 TTF_Font *clock_font                  = NULL;
-SDL_Thread *Slideshowhread            = NULL;
-SDL_Thread *clock_thread              = NULL;
 SDL_Event event;
 SDL_SysWMinfo wm_info;
 SDL_DisplayMode display_mode;
 TextInfo title_info;
+TextInfo search_info;
+SearchIndex search_index              = {0};
+Search search                         = {0};
 Ticks ticks;
 Geometry geo;
 Uint32 refresh_period;
@@ -246,14 +303,15 @@ static void create_window()
         if (!repeat_period)
             repeat_period = 1;
     }
-    if (slideshow != NULL)
-        slideshow->transition_change_rate = 255.0f / ((float) config.slideshow_transition_time / (float) refresh_period);
-
     renderer = SDL_CreateRenderer(window, -1, renderer_flags);
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
     if (renderer == NULL)
         log_fatal("Could not initialize renderer\n%s", SDL_GetError());
 
+    // Images are converted to the format the renderer uploads directly
+    texture_format = get_preferred_texture_format(renderer);
+    log_debug("Texture format: %s", SDL_GetPixelFormatName(texture_format));
+
     // Set background color
     set_draw_color();
 
@@ -323,11 +381,18 @@ static void init_sdl_ttf()
 // A function to close subsystems and free memory before quitting
 static void cleanup()
 {
-    // Wait until all threads have completed
-    SDL_WaitThread(Slideshowhread, NULL);
-    SDL_WaitThread(clock_thread, NULL);
+    // Wait until all threads have completed, then write out the trace
+#ifdef __unix__
+    quit_control();
+#endif
+    quit_workers();
+    quit_metrics();
+    quit_trace();
     
-    // Destroy renderer and window
+    // Destroy the slideshow textures, then the renderer and window
+    if (config.background_mode == BACKGROUND_SLIDESHOW)
+        quit_slideshow();
+    quit_text();
     if (renderer != NULL) {
         SDL_DestroyRenderer(renderer);
         renderer = NULL;
@@ -337,72 +402,41 @@ static void cleanup()
         window = NULL;
     }
 
+    // Write out pending log records and close the log file
+    quit_log();
+
     // Quit subsystems
     SDL_Quit();
     IMG_Quit();
     TTF_Quit();
     quit_svg();
-    if (config.background_mode == BACKGROUND_SLIDESHOW)
-        quit_slideshow();
 
-    // Close log file if open
-    if (log_file != NULL)
-        fclose(log_file);
 
     // Free dynamically allocated memory
-    free(config.default_menu);
-    free(config.background_image);
-    free(config.title_font_path);
     free(config.exe_path);
-    free(config.slideshow_directory);
-    free(config.clock_font_path);
-    free(config.gamepad_mappings_file);
-    free(config.startup_cmd);
-    free(config.quit_cmd);
     free(highlight);
     free(scroll);
     free(screensaver);
+    if (clk != NULL)
+        quit_clock(clk);
     free(clk);
 
-    // Free menu and entry linked lists
-    Entry *entry = NULL;
-    Entry *tmp_entry = NULL;
-    Menu *menu = config.first_menu;
-    Menu *tmp_menu = NULL;
-    for (size_t i = 0; i < config.num_menus; i++) {
-        free(menu->name);
-        entry = menu->first_entry;
-        for(size_t j = 0; j < menu->num_entries; j++) {
-            free(entry->title);
-            free(entry->icon_path);
-            free(entry->icon_selected_path);
-            free(entry->cmd);
-            tmp_entry = entry;
-            entry = entry->next;
-            free(tmp_entry);
-        }
-        tmp_menu = menu;
-        menu = menu->next;
-        free(tmp_menu);
-    }
-
-    // Free hotkey linked list
-    Hotkey *tmp_hotkey = NULL;
-    for(Hotkey *i = hotkeys; i != NULL; i = i->next) {
-        free(tmp_hotkey);
-        free(i->cmd);
-        tmp_hotkey = i;
-    }
-    free(tmp_hotkey);
-
-    // Free gamepad control linked list
-    GamepadControl *tmp_gamepad = NULL;
-    for (GamepadControl *i = gamepad_controls; i != NULL; i = i->next) {
-        free(tmp_gamepad);
-        free(i->cmd);
-        tmp_gamepad = i;
+    // Free the search index and results
+    free_search_index(&search_index);
+    for (int i = 0; i < SEARCH_SLOTS; i++)
+        free_text_layout(&search.slots[i].entry.title_layout);
+    free_text_layout(&search.prompt_layout);
+
+    // Free title layouts, then the menus, entries, hotkeys, gamepad
+    // controls and config strings in the arena all at once
+    for (Menu *menu = config.first_menu; menu != NULL; menu = menu->next) {
+        for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next)
+            free_text_layout(&entry->title_layout);
     }
-    free(tmp_gamepad);
+    free_arena(&config_arena);
+    config.first_menu = NULL;
+    hotkeys = NULL;
+    gamepad_controls = NULL;
 
     if (config.gamepad_enabled)
         disconnect_gamepad(-1, false, true);
@@ -414,11 +448,21 @@ static void handle_keypress(SDL_Keysym *key)
     if (config.debug)
         log_debug("Key %s (#%X) detected", SDL_GetKeyName(key->sym), key->sym);
 
+    // Keys edit the query and pick a result while searching
+    if (state.searching) {
+        handle_search_keypress(key);
+        return;
+    }
+
     // Check default keys
     if (key->sym == SDLK_LEFT)
         move_left();
     else if (key->sym == SDLK_RIGHT)
         move_right();
+    else if (config.rows > 1 && key->sym == SDLK_UP)
+        move_up();
+    else if (config.rows > 1 && key->sym == SDLK_DOWN)
+        move_down();
     else if (key->sym == SDLK_RETURN) {
         log_debug("Selected Entry:\n"
             "Title: %s\n"
@@ -429,7 +473,7 @@ static void handle_keypress(SDL_Keysym *key)
             current_entry->cmd
         );
         
-        execute_command(current_entry->cmd);
+        execute_command(current_entry->cmd, current_entry);
     }
     else if (key->sym == SDLK_BACKSPACE)
         load_back_menu(current_menu);
@@ -438,21 +482,219 @@ static void handle_keypress(SDL_Keysym *key)
     else {
         for (Hotkey *i = hotkeys; i != NULL; i = i->next) {
             if (key->sym == i->keycode) {
-                execute_command(i->cmd);
+                execute_command(i->cmd, NULL);
+                break;
+            }
+        }
+    }
+}
+
+// A function to enter search mode, where typing shows the matching entries
+// of all menus in a virtual menu
+static void start_search()
+{
+    if (state.searching || !search_index.num_items)
+        return;
+    log_debug("Starting search");
+    state.searching = true;
+    current_menu->last_selected_entry = current_entry;
+    search.origin = current_menu;
+    search.menu.name = SEARCH_MENU_NAME;
+    search.query[0] = '\0';
+    search_info = title_info;
+    search_info.max_width = geo.screen_width - 2*geo.screen_margin;
+    search_info.oversize_mode = OVERSIZE_TRUNCATE;
+    update_search();
+    SDL_StartTextInput();
+}
+
+// A function to lay out the search prompt and query centered above the buttons
+static void layout_search_prompt()
+{
+    char text[sizeof(SEARCH_PROMPT) + SEARCH_MAX_QUERY];
+    snprintf(text, sizeof(text), SEARCH_PROMPT "%s", search.query);
+    layout_text(text, &search_info, &search.prompt_layout, &search.prompt_rect, NULL);
+    search.prompt_rect.x = (geo.screen_width - search.prompt_rect.w) / 2;
+    search.prompt_rect.y = (geo.y_margin - config.highlight_vpadding - search.prompt_rect.h) / 2;
+}
+
+// A function to destroy the textures of a search slot so it can hold another entry
+static void clear_search_slot(SearchSlot *slot)
+{
+    if (slot->entry.icon != NULL)
+        SDL_DestroyTexture(slot->entry.icon);
+    if (slot->entry.icon_selected != NULL)
+        SDL_DestroyTexture(slot->entry.icon_selected);
+    free_text_layout(&slot->entry.title_layout);
+    slot->entry = (Entry) {0};
+    slot->source = NULL;
+}
+
+// A function to get the slot showing an entry in the search results. The
+// slot that had it last time is reused along with its textures, otherwise
+// a free slot with no icons pending is rendered. Returns NULL if all slots are busy
+static SearchSlot *get_search_slot(Entry *source)
+{
+    SearchSlot *free_slot = NULL;
+    for (int i = 0; i < SEARCH_SLOTS; i++) {
+        SearchSlot *slot = search.slots + i;
+        if (slot->source == source)
+            return slot;
+        if (!slot->used && !slot->pending_icons && (free_slot == NULL || slot->source == NULL))
+            free_slot = slot;
+    }
+    if (free_slot == NULL)
+        return NULL;
+    clear_search_slot(free_slot);
+    free_slot->source = source;
+    free_slot->entry.title = source->title;
+    free_slot->entry.icon_path = source->icon_path;
+    free_slot->entry.icon_selected_path = source->icon_selected_path;
+    free_slot->entry.cmd = source->cmd;
+    render_button(&free_slot->entry, &free_slot->pending_icons);
+    return free_slot;
+}
+
+// A function to narrow the results for the current query and show them
+static void update_search()
+{
+    SearchItem *results[SEARCH_MAX_RESULTS];
+    set_search_query(&search_index, search.query);
+    int num_results = get_search_results(&search_index, results, SEARCH_MAX_RESULTS);
+    layout_search_prompt();
+
+    // Claim the slots already showing results first, so they aren't
+    // handed out to new results
+    SearchSlot *slots[SEARCH_MAX_RESULTS] = {NULL};
+    for (int i = 0; i < SEARCH_SLOTS; i++)
+        search.slots[i].used = false;
+    for (int i = 0; i < num_results; i++) {
+        for (int j = 0; j < SEARCH_SLOTS; j++) {
+            if (search.slots[j].source == results[i]->entry) {
+                slots[i] = search.slots + j;
+                slots[i]->used = true;
                 break;
             }
         }
     }
+
+    // Link the results into the virtual menu
+    Entry *previous = NULL;
+    search.menu.first_entry = NULL;
+    search.menu.num_entries = 0;
+    for (int i = 0; i < num_results; i++) {
+        if (slots[i] == NULL)
+            slots[i] = get_search_slot(results[i]->entry);
+        if (slots[i] == NULL)
+            continue;
+        slots[i]->used = true;
+        Entry *entry = &slots[i]->entry;
+        entry->previous = previous;
+        entry->next = NULL;
+        if (previous == NULL)
+            search.menu.first_entry = entry;
+        else
+            previous->next = entry;
+        previous = entry;
+        search.menu.num_entries++;
+    }
+    search.menu.rendered = true;
+    if (search.menu.num_entries)
+        load_menu(&search.menu, false, true);
+    else {
+        current_menu = &search.menu;
+        current_entry = NULL;
+        search.menu.root_entry = NULL;
+        search.menu.page = 0;
+        search.menu.highlight_position = 0;
+        geo.num_buttons = 0;
+    }
+}
+
+// A function to append typed text to the search query
+static void add_search_text(const char *text)
+{
+    if (strlen(search.query) + strlen(text) > SEARCH_MAX_QUERY)
+        return;
+    strcat(search.query, text);
+    update_search();
+}
+
+// A function to handle a key press while searching
+static void handle_search_keypress(SDL_Keysym *key)
+{
+    if (key->sym == SDLK_ESCAPE)
+        end_search();
+    else if (key->sym == SDLK_BACKSPACE) {
+        size_t length = strlen(search.query);
+        if (!length)
+            end_search();
+        else {
+            // Remove the last UTF-8 character, including its continuation bytes
+            while (length > 0 && ((Uint8) search.query[--length] & 0xC0) == 0x80);
+            search.query[length] = '\0';
+            update_search();
+        }
+    }
+    else if (key->sym == SDLK_LEFT)
+        move_left();
+    else if (key->sym == SDLK_RIGHT)
+        move_right();
+    else if (key->sym == SDLK_UP)
+        move_up();
+    else if (key->sym == SDLK_DOWN)
+        move_down();
+    else if (key->sym == SDLK_RETURN)
+        select_search_result(current_entry);
+}
+
+// A function to leave search mode and run the command of a result, the
+// entry it was found from is credited with the launch
+static void select_search_result(Entry *result)
+{
+    if (result == NULL)
+        return;
+    Entry *source = ((SearchSlot*) result)->source;
+    log_debug("Selected search result '%s'", source->title);
+    end_search();
+    execute_command(source->cmd, source);
+}
+
+// A function to leave search mode and return to the menu it started from
+static void end_search()
+{
+    if (!state.searching)
+        return;
+    log_debug("Ending search");
+    state.searching = false;
+    SDL_StopTextInput();
+    search.query[0] = '\0';
+    set_search_query(&search_index, search.query);
+
+    // Free the textures of the results, slots with icons still being
+    // rasterized are cleared when they are reused
+    for (int i = 0; i < SEARCH_SLOTS; i++) {
+        search.slots[i].used = false;
+        if (!search.slots[i].pending_icons)
+            clear_search_slot(search.slots + i);
+    }
+    search.menu.first_entry = NULL;
+    search.menu.num_entries = 0;
+    load_menu(search.origin, false, false);
 }
 
 // A function to quit the slideshow mode in case of error or program exit
 void quit_slideshow()
 {
-    // Free allocated image paths
-    for (int i = 0; i < slideshow->num_images; i++)
-        free(slideshow->images[i]);
-    free(slideshow->images);
-    free(slideshow->order);
+    // Stop scanning and free the image paths
+    quit_scanner();
+
+    // The background texture outlives the slideshow in single image mode
+    for (int i = 0; i < SLIDESHOW_TEXTURES; i++) {
+        if (slideshow->textures[i] != NULL && slideshow->textures[i] != background_texture)
+            SDL_DestroyTexture(slideshow->textures[i]);
+    }
+    SDL_FreeSurface(slideshow->staging);
     free(slideshow);
 }
 
@@ -471,21 +713,31 @@ static void init_slideshow()
     // Allocate and initialize slideshow struct
     slideshow = malloc(sizeof(Slideshow));
     *slideshow = (Slideshow) {
-        .i = -1,
-        .num_images = 0,
-        .transition_surface = NULL,
+        .current = NULL,
+        .next = NULL,
         .transition_texture = NULL,
-        .transition_alpha = 0.f,
-        .transition_change_rate = 0.f,
-        .images = NULL,
-        .order = NULL
+        .textures = {NULL},
+        .front = 0,
+        .staging = NULL,
+        .staged = false,
+        .transition_alpha = 0.f
     };
 
-    // Find background images from directory
-    scan_slideshow_directory(slideshow, config.slideshow_directory);
-    
-    // Handle errors
-    if (!slideshow->num_images) {
+    // Find background images from the directory tree in the background
+    if (init_scanner(config.slideshow_directory)) {
+        log_error("Changing background mode to color");
+        config.background_mode = BACKGROUND_COLOR;
+        quit_slideshow();
+    }
+}
+
+// A function to wait for the first slideshow image, the rest of the
+// directory tree is scanned while the slideshow runs
+static void check_slideshow_images()
+{
+    bool scanned = false;
+    int num_images = wait_for_slideshow_images(&scanned);
+    if (scanned && !num_images) {
         log_error("No images found in slideshow directory '%s', "
             "Changing background mode to color", 
             config.slideshow_directory
@@ -493,24 +745,16 @@ static void init_slideshow()
         config.background_mode = BACKGROUND_COLOR;
         quit_slideshow();
     } 
-    else if (slideshow->num_images == 1) {
+    else if (scanned && num_images == 1) {
         log_error("Only one image found in slideshow directory %s"
             "Changing background mode to single image", 
             config.slideshow_directory
         );
-        free(config.background_image);
-        config.background_image = strdup(slideshow->images[0]);
+        SlideshowImage *image = next_slideshow_image(NULL, &num_images);
+        config.background_image = intern_string(&config_arena, image != NULL ? image->path : NULL);
         config.background_mode = BACKGROUND_IMAGE;
         quit_slideshow();
     }
-
-    // Generate array of random numbers for image order, load first image
-    else {
-        slideshow->order = malloc(sizeof(int) * (size_t) slideshow->num_images);
-        random_array(slideshow->order, slideshow->num_images);
-        if (config.debug)
-            debug_slideshow(slideshow);
-    }
 }
 
 // A function to initialize the screensaver feature
@@ -541,21 +785,9 @@ static void init_screensaver()
     else if (screensaver->alpha_end_value >= 255.0f)
         screensaver->alpha_end_value = 255.0f;
 
-    screensaver->transition_change_rate = screensaver->alpha_end_value / ((float) SCREENSAVER_TRANSITION_TIME / (float) refresh_period);
-    
-    // Render texture
-    SDL_Surface *surface = NULL;
-    surface = SDL_CreateRGBSurfaceWithFormat(0, 
-                  geo.screen_width, 
-                  geo.screen_height, 
-                  32,
-                  SDL_PIXELFORMAT_ARGB8888
-              );
-    Uint32 color = SDL_MapRGBA(surface->format, 0, 0, 0, 0xFF);
-    SDL_FillRect(surface, NULL, color);
-    screensaver->texture = load_texture(surface);
+    // The screen is darkened by blending black over it
+    screensaver->color = (SDL_Color) {0x00, 0x00, 0x00, 0xFF};
     screensaver->alpha = 0.0f;
-    SDL_SetTextureAlphaMod(screensaver->texture, 0.0f);
 }
 
 // A function to resume the slideshow after a launched application returns
@@ -583,10 +815,6 @@ static int load_menu(Menu *menu, bool set_back_menu, bool reset_position)
         return 1;
     }
 
-    // Render the menu if not already rendered
-    if (current_menu->rendered == false)
-        render_buttons(current_menu);
-
     // Set menu properties
     if (set_back_menu)
         current_menu->back = previous_menu;
@@ -600,16 +828,28 @@ static int load_menu(Menu *menu, bool set_back_menu, bool reset_position)
     else
         current_entry = current_menu->last_selected_entry;
 
+    // Render the menu if not already rendered, then make room for it
+    current_menu->last_visible = ++menu_visits;
+    if (current_menu->rendered == false) {
+        render_buttons(current_menu);
+        enforce_texture_budget();
+    }
+
+    // Load the rows of a virtual grid around a page that was reset
+    else if (is_virtual_grid(current_menu))
+        render_grid_rows(current_menu);
+
     buttons = current_menu->num_entries - (current_menu->page)*config.max_buttons;
-    if (buttons > config.max_buttons)
-        buttons = config.max_buttons;
+    if (buttons > config.rows*config.max_buttons)
+        buttons = config.rows*config.max_buttons;
     
     // Recalculate the screen geometry
     calculate_button_geometry(current_menu->root_entry, (int) buttons);
-    if (config.highlight) {
-        highlight->rect.x = current_entry->icon_rect.x - config.highlight_hpadding;
-        highlight->rect.y = current_entry->icon_rect.y - config.highlight_vpadding;
+    if (page_slide.active) {
+        cancel_tween(&page_slide.offset);
+        finish_page_slide(NULL);
     }
+    move_highlight(0);
     return 0;
 }
 
@@ -623,16 +863,17 @@ static int load_menu_by_name(const char *menu_name, bool set_back_menu, bool res
 // A function to calculate the layout of the buttons
 static void calculate_button_geometry(Entry *entry, int buttons)
 {
-    // Calculate proper spacing
-    geo.x_margin = (geo.screen_width - config.icon_size*buttons -
-                   buttons*config.icon_spacing + config.icon_spacing) / 2;
+    // Calculate proper spacing, rows of a grid line up with the first
+    int columns = MIN(buttons, (int) config.max_buttons);
+    geo.x_margin = (geo.screen_width - config.icon_size*columns -
+                   columns*config.icon_spacing + config.icon_spacing) / 2;
     geo.x_advance = config.icon_size + config.icon_spacing;
     geo.num_buttons = buttons;
 
     // Assign values to entries
     for (int i = 0; i < geo.num_buttons; i++) {
-            entry->icon_rect.x = geo.x_margin + i*geo.x_advance;
-            entry->icon_rect.y = geo.y_margin;
+            entry->icon_rect.x = geo.x_margin + (i % (int) config.max_buttons)*geo.x_advance;
+            entry->icon_rect.y = geo.y_margin + (i / (int) config.max_buttons)*geo.y_advance;
             entry->icon_rect.w = config.icon_size;
             entry->icon_rect.h = config.icon_size;
             entry->text_rect.x = entry->icon_rect.x +
@@ -643,37 +884,228 @@ static void calculate_button_geometry(Entry *entry, int buttons)
     }
 }
 
-// A function to render all buttons (icon and text) for a menu
-static void render_buttons(Menu *menu)
+// A function to render the icons and title of a button, pending counts
+// the icons still being rasterized
+static void render_button(Entry *entry, unsigned int *pending)
 {
-    Entry *entry;
     int h;
-    for (entry = menu->first_entry; entry != NULL; entry = entry->next) {
-        entry->icon = load_texture_from_file(entry->icon_path);
-        entry->icon_selected = (entry->icon_selected_path != NULL) ? load_texture_from_file(entry->icon_selected_path) : NULL;
-        if (config.titles_enabled) {
-            entry->title_texture = render_text_texture(entry->title, &title_info, &entry->text_rect, &h);
-            if (config.title_oversize_mode == OVERSIZE_SHRINK && h != geo.font_height)
-                entry->title_offset = (geo.font_height - h) / 2;
+    load_icon(entry->icon_path, &entry->icon, pending);
+    load_icon(entry->icon_selected_path, &entry->icon_selected, pending);
+    if (config.titles_enabled) {
+        layout_text(entry->title, &title_info, &entry->title_layout, &entry->text_rect, &h);
+        if (config.title_oversize_mode == OVERSIZE_SHRINK && h != geo.font_height)
+            entry->title_offset = (geo.font_height - h) / 2;
+    }
+}
+
+// A function to render all buttons (icon and text) for a menu, or the rows
+// around the screen for a grid
+static void render_buttons(Menu *menu)
+{
+    TRACE_BEGIN(render_buttons);
+    if (is_virtual_grid(menu))
+        render_grid_rows(menu);
+    else {
+        for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next) {
+            render_button(entry, &menu->pending_icons);
+            entry->rendered = true;
         }
     }
     menu->rendered = true;
+    TRACE_END(render_buttons);
+}
+
+// A function to check whether a menu only has the rows around the screen
+// rendered. The search results manage their own textures
+static bool is_virtual_grid(Menu *menu)
+{
+    return config.rows > 1 && menu != &search.menu;
+}
+
+// A function to get the entry at an index of a menu by walking from the
+// top left entry on screen
+static Entry *get_grid_entry(Menu *menu, unsigned int index)
+{
+    unsigned int root = menu->page*config.max_buttons;
+    if (index < root)
+        return advance_entries(menu->root_entry, (int) (root - index), DIRECTION_LEFT);
+    return advance_entries(menu->root_entry, (int) (index - root), DIRECTION_RIGHT);
+}
+
+// A function to render the rows of a grid on screen and the rows next to
+// them, and unload the rest so the textures held don't grow with the menu
+static void render_grid_rows(Menu *menu)
+{
+    unsigned int root = menu->page*config.max_buttons;
+    unsigned int margin = GRID_MARGIN_ROWS*config.max_buttons;
+    unsigned int first = root > margin ? root - margin : 0;
+    unsigned int last = MIN(root + config.rows*config.max_buttons + margin, menu->num_entries);
+
+    // Unload the entries which left the window, unless icons are still being
+    // rasterized because the finished jobs write into their entries
+    if (menu->loaded_first < menu->loaded_last && !menu->pending_icons) {
+        Entry *entry = get_grid_entry(menu, menu->loaded_first);
+        for (unsigned int i = menu->loaded_first; i < menu->loaded_last; i++, entry = entry->next) {
+            if (i < first || i >= last)
+                unload_button(entry);
+        }
+        menu->loaded_first = menu->loaded_last = 0;
+    }
+
+    // Render the entries which entered it
+    Entry *entry = get_grid_entry(menu, first);
+    for (unsigned int i = first; i < last; i++, entry = entry->next) {
+        if (!entry->rendered) {
+            render_button(entry, &menu->pending_icons);
+            entry->rendered = true;
+        }
+    }
+    if (menu->loaded_first == menu->loaded_last) {
+        menu->loaded_first = first;
+        menu->loaded_last = last;
+    }
+    else {
+        menu->loaded_first = MIN(menu->loaded_first, first);
+        menu->loaded_last = MAX(menu->loaded_last, last);
+    }
+}
+
+// A function to destroy the icon textures and title of a button
+static void unload_button(Entry *entry)
+{
+    if (entry->icon != NULL) {
+        SDL_DestroyTexture(entry->icon);
+        entry->icon = NULL;
+    }
+    if (entry->icon_selected != NULL) {
+        SDL_DestroyTexture(entry->icon_selected);
+        entry->icon_selected = NULL;
+    }
+    free_text_layout(&entry->title_layout);
+    entry->rendered = false;
+}
+
+// A function to destroy the icon textures of a menu, they are recreated
+// by render_buttons() the next time the menu is loaded
+static void unload_buttons(Menu *menu)
+{
+    for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next) {
+        if (entry->icon != NULL) {
+            SDL_DestroyTexture(entry->icon);
+            entry->icon = NULL;
+        }
+        if (entry->icon_selected != NULL) {
+            SDL_DestroyTexture(entry->icon_selected);
+            entry->icon_selected = NULL;
+        }
+        entry->rendered = false;
+    }
+    menu->rendered = false;
+    menu->texture_bytes = 0;
+    menu->loaded_first = menu->loaded_last = 0;
+}
+
+// A function to unload the least recently visible menus until the
+// textures of all rendered menus fit in the memory limit
+static void enforce_texture_budget()
+{
+    if (!config.texture_memory_limit)
+        return;
+    size_t total = 0;
+    for (Menu *menu = config.first_menu; menu != NULL; menu = menu->next) {
+        if (!menu->rendered)
+            continue;
+        menu->texture_bytes = 0;
+        for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next)
+            menu->texture_bytes += get_texture_bytes(entry->icon) + get_texture_bytes(entry->icon_selected);
+        total += menu->texture_bytes;
+    }
+
+    // Menus with icons still being rasterized are skipped, because the
+    // finished jobs write into their entries
+    while (total > config.texture_memory_limit) {
+        Menu *lru = NULL;
+        for (Menu *menu = config.first_menu; menu != NULL; menu = menu->next) {
+            if (!menu->rendered || menu == current_menu || menu->pending_icons)
+                continue;
+            if (lru == NULL || menu->last_visible < lru->last_visible)
+                lru = menu;
+        }
+        if (lru == NULL)
+            break;
+        log_debug("Unloading menu '%s' to free %u KB of textures",
+            lru->name,
+            (unsigned int) (lru->texture_bytes / 1024)
+        );
+        total -= lru->texture_bytes;
+        unload_buttons(lru);
+    }
+}
+
+// A function to move the highlight to the current entry
+static void move_highlight(Uint32 duration)
+{
+    if (!config.highlight)
+        return;
+    float x = (float) (current_entry->icon_rect.x - config.highlight_hpadding);
+    float y = (float) (current_entry->icon_rect.y - config.highlight_vpadding);
+    start_tween(&highlight->x, x, duration, EASING_OUT_CUBIC, NULL, NULL);
+    start_tween(&highlight->y, y, duration, EASING_OUT_CUBIC, NULL, NULL);
+}
+
+// A function to get how long the highlight takes to move to an adjacent entry
+static Uint32 get_highlight_transition_time()
+{
+    return config.animated_navigation ? HIGHLIGHT_TRANSITION_TIME : 0;
+}
+
+// A function to slide the current page in and the previous page out,
+// a page change during a slide restarts it from the page on screen
+static void slide_page(Entry *previous_root, int previous_buttons, int direction)
+{
+    if (!config.animated_navigation)
+        return;
+    page_slide.previous_root = previous_root;
+    page_slide.previous_buttons = previous_buttons;
+    page_slide.direction = direction;
+    page_slide.offset = (float) (direction * geo.screen_width);
+    page_slide.active = true;
+    start_tween(&page_slide.offset, 0.0f, PAGE_TRANSITION_TIME, EASING_OUT_CUBIC, finish_page_slide, NULL);
+}
+
+// A function to stop drawing the previous page when the slide finishes
+static void finish_page_slide(void *data)
+{
+    UNUSED(data);
+    page_slide.offset = 0.0f;
+    page_slide.previous_root = NULL;
+    page_slide.active = false;
 }
 
 // A function to move the selection left when clicked by user
 static void move_left()
 {
+    // Search results may be empty
+    if (current_entry == NULL)
+        return;
+    if (config.rows > 1) {
+        move_grid(-1);
+        return;
+    }
+
     // If we are not in leftmost position, move highlight left
     if (current_menu->highlight_position > 0) {
-        if (config.highlight)
-            highlight->rect.x -= geo.x_advance;
         current_menu->highlight_position--;
         current_entry = current_entry->previous;
+        move_highlight(get_highlight_transition_time());
     }
 
     // If we are in leftmost position...
     else if (current_menu->highlight_position == 0 && (current_menu->page > 0 || config.wrap_entries)) {
         unsigned int buttons;
+        Entry *previous_root = current_menu->root_entry;
+        int previous_buttons = geo.num_buttons;
+        unsigned int previous_page = current_menu->page;
         current_entry = current_entry->previous;
 
         // Load the previous page if there is a valid previous entry
@@ -696,21 +1128,31 @@ static void move_left()
         }
 
         calculate_button_geometry(current_menu->root_entry, (int) buttons);
-        if (config.highlight)
-            highlight->rect.x = current_entry->icon_rect.x - config.highlight_hpadding;
         current_menu->highlight_position = buttons - 1;
+        if (current_menu->page != previous_page) {
+            move_highlight(0);
+            slide_page(previous_root, previous_buttons, -1);
+        }
+        else
+            move_highlight(get_highlight_transition_time());
     }
 }
 
 // A function to move the selection right when clicked by the user
 static void move_right()
 {
+    if (current_entry == NULL)
+        return;
+    if (config.rows > 1) {
+        move_grid(1);
+        return;
+    }
+
     // If we are not in the rightmost position, move highlight right
     if ((int) current_menu->highlight_position < (geo.num_buttons - 1)) {
-        if (config.highlight)
-            highlight->rect.x += geo.x_advance;
         current_menu->highlight_position++;
         current_entry = current_entry->next;
+        move_highlight(get_highlight_transition_time());
     }
 
     // If we are in the rightmost postion, but there are more entries in the menu, load next page
@@ -719,27 +1161,103 @@ static void move_right()
         unsigned int buttons = current_menu->num_entries - (current_menu->page + 1)*config.max_buttons;
         if (buttons > config.max_buttons)
             buttons = config.max_buttons;
+        Entry *previous_root = current_menu->root_entry;
+        int previous_buttons = geo.num_buttons;
         current_entry = current_entry->next;
         current_menu->root_entry = current_entry;
         calculate_button_geometry(current_menu->root_entry, (int) buttons);
-        if (config.highlight)
-            highlight->rect.x = current_entry->icon_rect.x - config.highlight_hpadding;
+        move_highlight(0);
+        slide_page(previous_root, previous_buttons, 1);
         current_menu->page++;
         current_menu->highlight_position = 0;
     }
 
     // If user has the wrap entries setting, reset menu to first entry
     else if (config.wrap_entries) {
+        Entry *previous_root = current_menu->root_entry;
+        int previous_buttons = geo.num_buttons;
+        unsigned int previous_page = current_menu->page;
         current_entry = current_menu->first_entry;
         current_menu->root_entry = current_entry;
         current_menu->highlight_position = 0;
         current_menu->page = 0;
-        if (config.highlight)
-            highlight->rect.x = current_entry->icon_rect.x - config.highlight_hpadding;
         calculate_button_geometry(current_menu->root_entry, (int) MIN(current_menu->num_entries, config.max_buttons));
+        if (previous_page != 0) {
+            move_highlight(0);
+            slide_page(previous_root, previous_buttons, 1);
+        }
+        else
+            move_highlight(get_highlight_transition_time());
     }
 }
 
+// A function to move the selection up a row of a grid
+static void move_up()
+{
+    if (current_entry != NULL && config.rows > 1)
+        move_grid(-(int) config.max_buttons);
+}
+
+// A function to move the selection down a row of a grid
+static void move_down()
+{
+    if (current_entry != NULL && config.rows > 1)
+        move_grid((int) config.max_buttons);
+}
+
+// A function to move the selection of a grid by a number of entries, and
+// scroll the rows on screen just enough to show it
+static void move_grid(int step)
+{
+    int columns = (int) config.max_buttons;
+    int num_entries = (int) current_menu->num_entries;
+    int index = (int) (current_menu->page*config.max_buttons + current_menu->highlight_position);
+    int target = index + step;
+
+    // Moving down onto a shorter last row selects its last entry, and moving
+    // left or right past the ends of the menu wraps if the user has the setting
+    if (target < 0) {
+        if (step != -1 || !config.wrap_entries)
+            return;
+        target = num_entries - 1;
+    }
+    else if (target >= num_entries) {
+        if (step > 1 && (num_entries - 1) / columns > index / columns)
+            target = num_entries - 1;
+        else if (step == 1 && config.wrap_entries)
+            target = 0;
+        else
+            return;
+    }
+
+    // Walk to the new entry from the nearer of the current entry and the first
+    if (target > index)
+        current_entry = advance_entries(current_entry, target - index, DIRECTION_RIGHT);
+    else if (index - target <= target)
+        current_entry = advance_entries(current_entry, index - target, DIRECTION_LEFT);
+    else
+        current_entry = advance_entries(current_menu->first_entry, target, DIRECTION_RIGHT);
+
+    // Scroll the grid if the row of the new entry is off screen
+    int row = target / columns;
+    int page = (int) current_menu->page;
+    if (row < page)
+        page = row;
+    else if (row >= page + (int) config.rows)
+        page = row - (int) config.rows + 1;
+    if (page != (int) current_menu->page) {
+        current_menu->root_entry = advance_entries(current_entry, target - page*columns, DIRECTION_LEFT);
+        current_menu->page = (unsigned int) page;
+        if (is_virtual_grid(current_menu))
+            render_grid_rows(current_menu);
+        calculate_button_geometry(current_menu->root_entry,
+            MIN(num_entries - page*columns, (int) config.rows*columns)
+        );
+    }
+    current_menu->highlight_position = (unsigned int) (target - page*columns);
+    move_highlight(get_highlight_transition_time());
+}
+
 // A function to load a submenu
 static void load_submenu(const char *submenu)
 {
@@ -753,63 +1271,95 @@ static void load_back_menu(Menu *menu)
     load_menu(menu->back, false, config.reset_on_back);
 }
 
+// A function to draw a page of buttons shifted horizontally by an offset
+static void draw_buttons(Entry *entry, int buttons, int offset, int highlight_position)
+{
+    SDL_Texture *icon;
+    SDL_Rect icon_rect;
+    SDL_Rect text_rect;
+    for (int i = 0; i < buttons && entry != NULL; i++) {
+        icon = (entry->icon_selected != NULL && i == highlight_position) ? entry->icon_selected : entry->icon;
+        icon_rect = entry->icon_rect;
+        icon_rect.x += offset;
+        SDL_RenderCopy(renderer, icon, NULL, &icon_rect);
+        if (config.titles_enabled) {
+            text_rect = entry->text_rect;
+            text_rect.x += offset;
+            draw_text(&entry->title_layout, &title_info, &text_rect);
+        }
+        entry = entry->next;
+    }
+}
+
 // A function to update the screen with all visible textures
 static void draw_screen()
 {
+    TRACE_BEGIN(draw_screen);
+    Uint64 frame_start = METRICS_START();
+
     // Draw background
     SDL_RenderClear(renderer);
     if (!(state.application_launching && config.on_launch == ON_LAUNCH_BLANK)) {
         if (config.background_mode == BACKGROUND_IMAGE || config.background_mode == BACKGROUND_SLIDESHOW)
             SDL_RenderCopy(renderer, background_texture, NULL, NULL);
 
-        if (config.background_mode == BACKGROUND_SLIDESHOW && state.slideshow_transition)
+        if (config.background_mode == BACKGROUND_SLIDESHOW && state.slideshow_transition) {
+            SDL_SetTextureAlphaMod(slideshow->transition_texture, (Uint8) slideshow->transition_alpha);
             SDL_RenderCopy(renderer, slideshow->transition_texture, NULL, NULL);
+        }
 
-        // Draw background overlay
-        if (config.background_overlay)
-            SDL_RenderCopy(renderer, background_overlay, NULL, NULL);
+        // Draw background overlay, background images have it composited in
+        if (config.background_overlay && config.background_mode != BACKGROUND_IMAGE && 
+        config.background_mode != BACKGROUND_SLIDESHOW)
+            draw_color_layer(&config.background_overlay_color, config.background_overlay_color.a);
 
         // Draw scroll indicators
         if (config.scroll_indicators &&
-        (current_menu->page*config.max_buttons + (unsigned int) geo.num_buttons) <= (current_menu->num_entries - 1))
+        (current_menu->page*config.max_buttons + (unsigned int) geo.num_buttons) < current_menu->num_entries)
             SDL_RenderCopy(renderer, scroll->texture, NULL, &scroll->rect_right);
 
         if (config.scroll_indicators && current_menu->page > 0)
             SDL_RenderCopyEx(renderer, scroll->texture, NULL, &scroll->rect_left, 0, NULL, SDL_FLIP_HORIZONTAL);
 
         // Draw clock
-        if (config.clock_enabled) {
-            SDL_RenderCopy(renderer, clk->time_texture, NULL, &clk->time_rect);
-            if (config.clock_show_date)
-                SDL_RenderCopy(renderer, clk->date_texture, NULL, &clk->date_rect);
-        }
-
-        // Draw highlight
-        if (config.highlight)
+        if (config.clock_enabled)
+            draw_clock(clk);
+
+        // Draw search query
+        if (state.searching)
+            draw_text(&search.prompt_layout, &search_info, &search.prompt_rect);
+
+        // Draw highlight, it moves with the page when the page changes
+        int offset = (int) page_slide.offset;
+        if (config.highlight && current_entry != NULL) {
+            highlight->rect.x = (int) (highlight->x + 0.5f) + offset;
+            highlight->rect.y = (int) (highlight->y + 0.5f);
             SDL_RenderCopy(renderer,
                 highlight->texture,
                 NULL,
                 &highlight->rect
             );
+        }
 
-        // Draw buttons
-        Entry *entry = current_menu->root_entry;
-        SDL_Texture *icon;
-        for (int i = 0; i < geo.num_buttons; i++) {
-            icon = (entry->icon_selected != NULL && i == (int) current_menu->highlight_position) ? entry->icon_selected : entry->icon;
-            SDL_RenderCopy(renderer, icon, NULL, &entry->icon_rect);
-            if (config.titles_enabled)
-                SDL_RenderCopy(renderer, entry->title_texture, NULL, &entry->text_rect);
-            entry = entry-> next;
+        // Draw buttons, and the previous page while it slides out
+        draw_buttons(current_menu->root_entry, geo.num_buttons, offset, (int) current_menu->highlight_position);
+        if (page_slide.active) {
+            draw_buttons(page_slide.previous_root,
+                page_slide.previous_buttons,
+                offset - page_slide.direction * geo.screen_width,
+                -1
+            );
         }
 
         // Draw screensaver
         if (state.screensaver_active)
-            SDL_RenderCopy(renderer, screensaver->texture, NULL, NULL);
+            draw_color_layer(&screensaver->color, (Uint8) screensaver->alpha);
     }
 
     // Output to screen
     SDL_RenderPresent(renderer);
+    RECORD_DURATION(frame_time, frame_start);
+    TRACE_END(draw_screen);
     if (!config.vsync) {
         Uint32 sleep_time = refresh_period - (SDL_GetTicks() - ticks.main);
         if (sleep_time > 0)
@@ -817,8 +1367,9 @@ static void draw_screen()
     }
 }
 
-// A function to execute the user's command
-static void execute_command(const char *command)
+// A function to execute the user's command, the entry it belongs to is
+// credited with the launch if any
+static void execute_command(const char *command, Entry *entry)
 {
     // Copy command into separate buffer
     char *cmd = strdup(command);
@@ -829,24 +1380,46 @@ static void execute_command(const char *command)
         char *special_command = strtok(cmd, delimiter);
         if (!strcmp(special_command, SCMD_SUBMENU)) {
             char *submenu = strtok(NULL, "");
-            if (submenu != NULL)
+            if (submenu != NULL) {
+                end_search();
                 load_submenu(submenu);
+            }
         }
         else if (!strcmp(special_command, SCMD_FORK)) {
             char *fork_command = strtok(NULL, "");
-            if (fork_command != NULL)
+            if (fork_command != NULL) {
+                TRACE_BEGIN(start_process);
                 start_process(fork_command, false);
+                TRACE_END(start_process);
+            }
         }
         else if (!strcmp(special_command, SCMD_LEFT))
             move_left();
         else if (!strcmp(special_command, SCMD_RIGHT))
             move_right();
-        else if (!strcmp(special_command, SCMD_SELECT))
-            execute_command(current_entry->cmd);
-        else if (!strcmp(special_command, SCMD_HOME))
+        else if (!strcmp(special_command, SCMD_UP))
+            move_up();
+        else if (!strcmp(special_command, SCMD_DOWN))
+            move_down();
+        else if (!strcmp(special_command, SCMD_SELECT)) {
+            if (state.searching)
+                select_search_result(current_entry);
+            else
+                execute_command(current_entry->cmd, current_entry);
+        }
+        else if (!strcmp(special_command, SCMD_HOME)) {
+            if (state.searching)
+                end_search();
             load_menu(default_menu, false, true);
-        else if (!strcmp(special_command, SCMD_BACK))
-            load_back_menu(current_menu);
+        }
+        else if (!strcmp(special_command, SCMD_BACK)) {
+            if (state.searching)
+                end_search();
+            else
+                load_back_menu(current_menu);
+        }
+        else if (!strcmp(special_command, SCMD_SEARCH))
+            start_search();
         else if (!strcmp(special_command, SCMD_QUIT))
             quit(EXIT_SUCCESS);
         else if (!strcmp(special_command, SCMD_SHUTDOWN))
@@ -860,9 +1433,13 @@ static void execute_command(const char *command)
     // Launch external application
     else {
         SDL_Delay(50);
-        if (start_process(cmd, true)) {
+        TRACE_BEGIN(start_process);
+        bool started = start_process(cmd, true);
+        TRACE_END(start_process);
+        if (started) {
             state.application_launching = true;
             ticks.application_launched = ticks.main;
+            launched_entry = entry;
             if (config.on_launch == ON_LAUNCH_BLANK)
                 SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
             else if (config.on_launch == ON_LAUNCH_QUIT)
@@ -872,6 +1449,89 @@ static void execute_command(const char *command)
     free(cmd);
 }
 
+#ifdef __unix__
+// A function to check whether a special command may be run from the control
+// socket. Commands that start arbitrary processes are only accepted from the
+// config file
+static bool is_control_command(const char *command)
+{
+    static const char *commands[] = {
+        SCMD_SELECT,
+        SCMD_SUBMENU,
+        SCMD_LEFT,
+        SCMD_RIGHT,
+        SCMD_UP,
+        SCMD_DOWN,
+        SCMD_HOME,
+        SCMD_BACK,
+        SCMD_QUIT,
+        SCMD_SHUTDOWN,
+        SCMD_RESTART,
+        SCMD_SLEEP
+    };
+    size_t length = strcspn(command, " ");
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        if (strlen(commands[i]) == length && !strncmp(command, commands[i], length))
+            return true;
+    }
+    return false;
+}
+
+// A function to run a command received on the control socket, either a
+// special command or the title of an entry in the current menu to launch,
+// and reply with the resulting menu and selection
+static void handle_control_request(ControlRequest *request)
+{
+    const char *command = request->command;
+    log_debug("Control command '%s'", command);
+
+    // Don't act on the menu behind a running application, a second launch
+    // would lose track of the first
+    if (state.application_launching || state.application_running) {
+        snprintf(request->reply, CONTROL_REPLY_SIZE, "ERR Application running");
+        return;
+    }
+    if (command[0] == ':') {
+        if (!is_control_command(command)) {
+            snprintf(request->reply, CONTROL_REPLY_SIZE, "ERR Unknown command");
+            return;
+        }
+        ticks.last_input = ticks.main;
+        execute_command(command, NULL);
+    }
+    else {
+        Entry *entry = current_menu->first_entry;
+        while (entry != NULL && (entry->title == NULL || strcmp(entry->title, command)))
+            entry = entry->next;
+        if (entry == NULL) {
+            snprintf(request->reply, CONTROL_REPLY_SIZE, "ERR No entry '%s' in menu '%s'", command, current_menu->name);
+            return;
+        }
+        ticks.last_input = ticks.main;
+        if (state.searching)
+            select_search_result(entry);
+        else
+            execute_command(entry->cmd, entry);
+    }
+
+    // Report the 1-based position of the selection in the menu, search
+    // results may have no selection
+    int position = 0;
+    if (current_entry != NULL) {
+        position = 1;
+        for (Entry *entry = current_menu->first_entry; entry != NULL && entry != current_entry; entry = entry->next)
+            position++;
+    }
+    snprintf(request->reply,
+        CONTROL_REPLY_SIZE,
+        "OK\t%s\t%i\t%s",
+        current_menu->name,
+        position,
+        current_entry != NULL && current_entry->title != NULL ? current_entry->title : ""
+    );
+}
+#endif
+
 // A function to initialize the gamepad struct
 static void init_gamepad(Gamepad **gamepad, int device_index)
 {
@@ -1000,65 +1660,93 @@ static void poll_gamepad()
         if (i->repeat == 1) {
             log_debug("Gamepad %s detected", i->label);
             ticks.last_input = ticks.main;
-            execute_command(i->cmd);
+            execute_command(i->cmd, NULL);
         }
         else if (i->repeat == delay_period) {
             ticks.last_input = ticks.main;
-            execute_command(i->cmd);
+            execute_command(i->cmd, NULL);
             i->repeat -= repeat_period;
         }
     }
 }
 
+// A function to decode the next slideshow background on a worker thread
+static void decode_slideshow_background(void *data)
+{
+    Slideshow *slideshow = (Slideshow*) data;
+    slideshow->staged = stage_slideshow_background(slideshow, decode_next_slideshow_background(slideshow));
+}
+
+// A function to convert a decoded slideshow background to a texture on the main thread
+static void finish_slideshow_background(void *data)
+{
+    Slideshow *slideshow = (Slideshow*) data;
+    state.slideshow_background_rendering = false;
+    if (!check_slideshow_background(slideshow, slideshow->staged)) {
+        ticks.slideshow_load = ticks.main;
+        return;
+    }
+    SDL_Texture *texture = upload_slideshow_background(slideshow);
+    if (config.slideshow_transition_time > 0) {
+        slideshow->transition_texture = texture;
+        slideshow->transition_alpha = 0.0f;
+        state.slideshow_transition = true;
+        start_tween(&slideshow->transition_alpha,
+            255.0f,
+            config.slideshow_transition_time,
+            EASING_LINEAR,
+            finish_slideshow_transition,
+            slideshow
+        );
+    }
+    else {
+        swap_slideshow_textures(slideshow);
+        ticks.slideshow_load = ticks.main;
+    }
+}
+
 // A function to update the slideshow
 static void update_slideshow()
 {
-    // If image duration time has elapsed, load the next image and start the transition
+    // If image duration time has elapsed, decode the next image on a worker
+    // thread so we don't block the main thread. The transition starts when
+    // the job completes.
     if (!state.slideshow_transition && (ticks.main - ticks.slideshow_load > config.slideshow_image_duration) &&
-    !state.slideshow_paused) {
-        
-        // Render the new background image in a separate thread so we don't block the main thread
-        if (!state.slideshow_background_rendering && !state.slideshow_background_ready) {
-            Slideshowhread = SDL_CreateThread(load_next_slideshow_background_async, "Slideshow Thread", (void*) slideshow);
-            state.slideshow_background_rendering = true;
-        }
-
-        // Convert background to texture after the rendering thread has completed
-        else if (state.slideshow_background_ready) {
-            SDL_WaitThread(Slideshowhread, NULL);
-            Slideshowhread = NULL;
-            if (config.slideshow_transition_time > 0) {
-                slideshow->transition_texture = load_texture(slideshow->transition_surface);
-                SDL_SetTextureAlphaMod(slideshow->transition_texture, 0);
-                state.slideshow_transition = true;
-            }
-            else {
-                SDL_DestroyTexture(background_texture);
-                background_texture = load_texture(slideshow->transition_surface);
-                ticks.slideshow_load = ticks.main;
-            }
-        slideshow->transition_surface = NULL;
-        state.slideshow_background_ready = false;
-        }
-    }
-    else if (state.slideshow_transition) {
-        
-        // Increase the transparency
-        slideshow->transition_alpha += slideshow->transition_change_rate;
-        
-        // If transition is done, destroy old background and replace it with the new one
-        if (slideshow->transition_alpha >= 255.0f) {
-            SDL_SetTextureAlphaMod(slideshow->transition_texture, 0xFF);
-            slideshow->transition_alpha = 0.0f;
-            SDL_DestroyTexture(background_texture);
-            background_texture = slideshow->transition_texture;
-            slideshow->transition_texture = NULL;
-            state.slideshow_transition = false;
-            ticks.slideshow_load = ticks.main;
+    !state.slideshow_paused && !state.slideshow_background_rendering) {
+        state.slideshow_background_rendering = submit_job(decode_slideshow_background,
+                                                   finish_slideshow_background,
+                                                   (void*) slideshow
+                                               );
+        if (!state.slideshow_background_rendering) {
+            decode_slideshow_background(slideshow);
+            finish_slideshow_background(slideshow);
         }
-        else
-            SDL_SetTextureAlphaMod(slideshow->transition_texture, (Uint8) slideshow->transition_alpha);
+        if (config.background_mode != BACKGROUND_SLIDESHOW)
+            return;
     }
+
+    // Wake up when the current image has been shown for its full duration
+    if (!state.slideshow_transition && !state.slideshow_paused && !state.slideshow_background_rendering)
+        schedule_wakeup(ticks.slideshow_load + config.slideshow_image_duration + 1);
+}
+
+// A function to replace the old background with the new one when the crossfade finishes
+static void finish_slideshow_transition(void *data)
+{
+    Slideshow *slideshow = (Slideshow*) data;
+    SDL_SetTextureAlphaMod(slideshow->transition_texture, 0xFF);
+    slideshow->transition_alpha = 0.0f;
+    swap_slideshow_textures(slideshow);
+    slideshow->transition_texture = NULL;
+    state.slideshow_transition = false;
+    ticks.slideshow_load = ticks.main;
+}
+
+// A function to end the screensaver transition once the screen is dark
+static void finish_screensaver_transition(void *data)
+{
+    UNUSED(data);
+    state.screensaver_transition = false;
 }
 
 // A function to update the screensaver
@@ -1070,23 +1758,21 @@ static void update_screensaver()
         state.screensaver_transition = true;
         if (config.background_mode == BACKGROUND_SLIDESHOW && config.screensaver_pause_slideshow)
             state.slideshow_paused = true;
-    }
-    else {
 
         // Transition the screen to dark
-        if (state.screensaver_transition) {
-            screensaver->alpha += screensaver->transition_change_rate;
-            if (screensaver->alpha >= screensaver->alpha_end_value) {
-                SDL_SetTextureAlphaMod(screensaver->texture, (Uint8) screensaver->alpha_end_value);
-                state.screensaver_transition = false;
-            }
-            else
-                SDL_SetTextureAlphaMod(screensaver->texture, (Uint8) screensaver->alpha);
-        }
+        start_tween(&screensaver->alpha,
+            screensaver->alpha_end_value,
+            SCREENSAVER_TRANSITION_TIME,
+            EASING_LINEAR,
+            finish_screensaver_transition,
+            NULL
+        );
+    }
+    else {
 
         // User has pressed input, deactivate the screensaver
         if (state.screensaver_active && ticks.last_input == ticks.main) {
-            SDL_SetTextureAlphaMod(screensaver->texture, 0);
+            cancel_tween(&screensaver->alpha);
             screensaver->alpha = 0.0f;
             state.screensaver_active = false;
             state.screensaver_transition = false;
@@ -1099,46 +1785,60 @@ static void update_screensaver()
             }
         }
     }
+
+    // Wake up when the idle time runs out
+    if (!state.screensaver_active)
+        schedule_wakeup(ticks.last_input + config.screensaver_idle_time + 1);
 }
 
 // A function to update the clock display
-static void update_clock(bool block)
-{
-    if (ticks.main - ticks.clock_update > CLOCK_UPDATE_PERIOD) {
-        if (!state.clock_rendering) {
-
-            // Check to see if the time has changed
-            get_time(clk);
-            if (clk->render_time) {
-                state.clock_rendering = true;
-                if (block)
-                    render_clock(clk);
-                else
-                    clock_thread = SDL_CreateThread(render_clock_async, "Clock Thread", (void*) clk); 
-            }
-            else
-                ticks.clock_update = ticks.main;
-        }
+static void update_clock()
+{
+    // Wake up on the minute boundary, or shortly after if the tick
+    // counter and the wall clock have drifted apart
+    if (SDL_TICKS_PASSED(ticks.main, ticks.clock_update)) {
+        get_time(clk);
+        if (clk->render_time)
+            render_clock(clk);
+        ticks.clock_update = ticks.main + get_time_to_next_minute();
+    }
+    schedule_wakeup(ticks.clock_update);
+}
 
-        // Render texture
-        if (state.clock_ready) {
-            SDL_WaitThread(clock_thread, NULL);
-            clock_thread = NULL;
-            SDL_DestroyTexture(clk->time_texture);
-            clk->time_texture = load_texture(clk->time_surface);
-            clk->time_surface = NULL;
-            if (clk->render_date) {
-                SDL_DestroyTexture(clk->date_texture);
-                clk->date_texture = load_texture(clk->date_surface);
-                clk->date_surface = NULL;
-            }
-            ticks.clock_update = ticks.main;
-            clk->render_time = false;
-            clk->render_date = false;
-            state.clock_rendering = false;
-            state.clock_ready = false;
-        }
+// A function to register a deadline the main loop must wake up for
+static void schedule_wakeup(Uint32 deadline)
+{
+    if (!state.wakeup_scheduled || SDL_TICKS_PASSED(ticks.wakeup, deadline)) {
+        ticks.wakeup = deadline;
+        state.wakeup_scheduled = true;
+    }
+}
+
+// A function to check whether the screen can stay static until the next event or deadline
+static bool is_idle()
+{
+    if (state.application_launching)
+        return false;
+
+    // Held gamepad controls need polling every frame for repeats
+    for (GamepadControl *i = gamepad_controls; i != NULL; i = i->next) {
+        if (i->repeat)
+            return false;
+    }
+    return true;
+}
+
+// A function to sleep until an event arrives or the earliest deadline passes
+static void wait_for_wakeup()
+{
+    if (!state.wakeup_scheduled)
+        SDL_WaitEvent(NULL);
+    else {
+        Uint32 now = SDL_GetTicks();
+        if (!SDL_TICKS_PASSED(now, ticks.wakeup))
+            SDL_WaitEventTimeout(NULL, (int) (ticks.wakeup - now));
     }
+    state.wakeup_scheduled = false;
 }
 
 static inline void pre_launch()
@@ -1163,7 +1863,7 @@ static inline void post_launch()
     if (config.gamepad_enabled)
         connect_gamepad(-1, true, false);
     if (config.clock_enabled)
-        update_clock(true);
+        update_clock();
     if (config.background_mode == BACKGROUND_SLIDESHOW)
         resume_slideshow();
     if (config.on_launch == ON_LAUNCH_BLANK)
@@ -1187,8 +1887,8 @@ void quit(int status)
             NULL
         );
     if (config.quit_cmd != NULL) {
-        execute_command(config.quit_cmd);
-        free(config.quit_cmd);
+        execute_command(config.quit_cmd, NULL);
+        config.quit_cmd = NULL;
     }
     cleanup();
     exit(status);
@@ -1241,6 +1941,18 @@ int main(int argc, char *argv[])
     init_svg();
     create_window();
 
+    // Start the worker threads for background decoding, jobs run
+    // synchronously if this fails
+    init_workers();
+    if (config.metrics_file != NULL)
+        init_metrics(config.metrics_file);
+
+    // Start accepting commands from other programs
+#ifdef __unix__
+    if (config.control_socket != NULL)
+        init_control(config.control_socket);
+#endif
+
     // Initialize timing
     ticks.main = SDL_GetTicks();
     ticks.last_input = ticks.main;
@@ -1256,12 +1968,14 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Render background
+    // Render background, a slideshow with a single image shows it as the background image
+    if (config.background_mode == BACKGROUND_SLIDESHOW)
+        check_slideshow_images();
     if (config.background_mode == BACKGROUND_IMAGE) {
         if (config.background_image == NULL)
             log_error("Background 'Image' setting not specified in config file");
         else
-            background_texture = load_texture_from_file(config.background_image);
+            background_texture = load_background_from_file(config.background_image);
 
         // Switch to color mode if loading background image failed
         if (background_texture == NULL) {
@@ -1271,10 +1985,16 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Render first slideshow image
+    // Create the textures the slideshow streams through, render first image
     else if (config.background_mode == BACKGROUND_SLIDESHOW) {
-        SDL_Surface *surface = load_next_slideshow_background(slideshow, false);
-        background_texture = load_texture(surface);
+        if (!create_slideshow_textures(slideshow, geo.screen_width, geo.screen_height)) {
+            log_error("Changing background to color mode");
+            quit_slideshow();
+            config.background_mode = BACKGROUND_COLOR;
+            set_draw_color();
+        }
+        else if (load_next_slideshow_background(slideshow))
+            swap_slideshow_textures(slideshow);
     }
 
     // Initialize screensaver
@@ -1285,9 +2005,14 @@ int main(int argc, char *argv[])
     if (config.clock_enabled) {
         clk = malloc(sizeof(Clock));
         init_clock(clk);
-        ticks.clock_update = ticks.main;
+        ticks.clock_update = ticks.main + get_time_to_next_minute();
     }
     
+    // Index the entries of all menus for search, text input is only
+    // enabled while searching
+    build_search_index(&search_index, config.first_menu);
+    SDL_StopTextInput();
+
     // Render highlight
     if (config.highlight) {
         int button_height = config.icon_size + config.title_padding + geo.font_height;
@@ -1306,25 +2031,6 @@ int main(int argc, char *argv[])
         render_scroll_indicators(scroll, scroll_indicator_height, &geo);
     }
 
-    // Render background overlay
-    if (config.background_overlay) {
-        SDL_Surface *overlay_surface = NULL;
-        overlay_surface = SDL_CreateRGBSurfaceWithFormat(0, 
-                              geo.screen_width, 
-                              geo.screen_height, 
-                              32,
-                              SDL_PIXELFORMAT_ARGB8888
-                          );
-        Uint32 overlay_color = SDL_MapRGBA(overlay_surface->format, 
-                                   config.background_overlay_color.r, 
-                                   config.background_overlay_color.g, 
-                                   config.background_overlay_color.b, 
-                                   config.background_overlay_color.a
-                               );
-        SDL_FillRect(overlay_surface, NULL, overlay_color);
-        background_overlay = load_texture(overlay_surface);
-    }
-
     // Register exit hotkey with Windows
 #ifdef _WIN32
     if (has_exit_hotkey())
@@ -1347,7 +2053,7 @@ int main(int argc, char *argv[])
 
     // Execute startup command
     if (config.startup_cmd != NULL)
-        execute_command(config.startup_cmd);
+        execute_command(config.startup_cmd, NULL);
     
     // Main program loop
     log_debug("Begin program loop");
@@ -1367,7 +2073,17 @@ int main(int argc, char *argv[])
                 case SDL_MOUSEBUTTONDOWN:
                     if (config.mouse_select && event.button.button == SDL_BUTTON_LEFT) {
                         ticks.last_input = ticks.main;
-                        execute_command(current_entry->cmd);
+                        if (state.searching)
+                            select_search_result(current_entry);
+                        else
+                            execute_command(current_entry->cmd, current_entry);
+                    }
+                    break;
+
+                case SDL_TEXTINPUT:
+                    if (state.searching) {
+                        ticks.last_input = ticks.main;
+                        add_search_text(event.text.text);
                     }
                     break;
 
@@ -1395,6 +2111,16 @@ int main(int argc, char *argv[])
                             log_debug("Application detected");
                             state.application_launching = false;
                             state.application_running = true;
+                            ticks.application_detected = SDL_GetTicks();
+                            if (metrics_enabled) {
+                                Uint64 elapsed = (Uint64) (ticks.application_detected - ticks.application_launched) * 1000;
+                                Uint32 latency = elapsed > SDL_MAX_UINT32 ? SDL_MAX_UINT32 : (Uint32) elapsed;
+                                record_histogram(&metrics.launch_latency, latency);
+                                if (launched_entry != NULL) {
+                                    launched_entry->launches++;
+                                    launched_entry->launch_latency += latency;
+                                }
+                            }
                             pre_launch();
                         }
 #ifdef _WIN32
@@ -1417,13 +2143,34 @@ int main(int argc, char *argv[])
             }
         }
 
+        // Finish jobs completed by the worker threads, and count the icons
+        // which arrived against the texture budget
+        process_completed_jobs();
+        if (state.icons_loaded) {
+            state.icons_loaded = false;
+            enforce_texture_budget();
+        }
+#ifdef __unix__
+        process_control_requests(handle_control_request);
+#endif
+
         // Update application state
         if (state.application_running && state.has_focus && !process_running()) {
             state.application_running = false;
+            ADD_COUNTER(applications_finished, 1);
+            ADD_COUNTER(application_wait, SDL_GetTicks() - ticks.application_detected);
             post_launch();
             log_debug("Application finished");
         }
 
+        // Write out metrics periodically, even while an application is running
+        if (metrics_enabled) {
+            update_metrics(ticks.main);
+            schedule_wakeup(metrics.next_write);
+        }
+        if (tracing)
+            schedule_wakeup(update_trace(ticks.main));
+
         // Post-event loop updates
         if (!(state.application_running || state.application_launching)) {
             if (gamepads != NULL)
@@ -1433,7 +2180,12 @@ int main(int argc, char *argv[])
             if (config.screensaver_enabled)
                 update_screensaver();
             if (config.clock_enabled)
-                update_clock(false);
+                update_clock();
+
+            // Advance animations, they need the next frame right away
+            Uint32 deadline;
+            if (update_tweens(ticks.main, &deadline))
+                schedule_wakeup(deadline);
         }
         if (state.application_launching &&
         ticks.main - ticks.application_launched > config.application_timeout) {
@@ -1443,8 +2195,12 @@ int main(int argc, char *argv[])
         }
         if (state.application_running)
             SDL_Delay(APPLICATION_WAIT_PERIOD);
-        else
+        else {
             draw_screen();
+            if (is_idle())
+                wait_for_wakeup();
+        }
+        state.wakeup_scheduled = false;
     }
     quit(EXIT_SUCCESS);
 }
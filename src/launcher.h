@@ -22,7 +22,6 @@
 #define GAMEPAD_DEADZONE 10000
 #define GAMEPAD_REPEAT_DELAY 500
 #define GAMEPAD_REPEAT_INTERVAL 25
-#define CLOCK_UPDATE_PERIOD 1000
 #define SCROLL_INDICATOR_HEIGHT 0.11F
 #define MAX_SCROLL_INDICATOR_OUTLINE 0.01F
 #define SCREEN_MARGIN 0.05F
@@ -32,12 +31,17 @@
 #define MIN_SLIDESHOW_IMAGE_DURATION 5000
 #define MAX_SLIDESHOW_IMAGE_DURATION 3600000
 #define MAX_SLIDESHOW_TRANSITION_TIME 3000
+#define SLIDESHOW_TEXTURES 2 // Front and back textures the backgrounds are streamed through
 #define MIN_SCREENSAVER_IDLE_TIME 3
 #define MAX_SCREENSAVER_IDLE_TIME 900
 #define SCREENSAVER_TRANSITION_TIME 1500
+#define HIGHLIGHT_TRANSITION_TIME 120
+#define PAGE_TRANSITION_TIME 250
+#define GRID_MARGIN_ROWS 1 // Rows loaded on each side of the rows on screen
 #define APPLICATION_WAIT_PERIOD 100
 #define MIN_APPLICATION_TIMEOUT 3
 #define MAX_APPLICATION_TIMEOUT 30
+#define BYTES_PER_MEGABYTE 1048576
 
 // Special commands
 #define SCMD_SELECT ":select"
@@ -46,12 +50,15 @@
 #define SCMD_EXIT ":exit"
 #define SCMD_LEFT ":left"
 #define SCMD_RIGHT ":right"
+#define SCMD_UP ":up"
+#define SCMD_DOWN ":down"
 #define SCMD_HOME ":home"
 #define SCMD_BACK ":back"
 #define SCMD_QUIT ":quit"
 #define SCMD_SHUTDOWN ":shutdown"
 #define SCMD_RESTART ":restart"
 #define SCMD_SLEEP ":sleep"
+#define SCMD_SEARCH ":search"
 
 typedef enum {
     MODE_SETTING_BACKGROUND,
@@ -116,24 +123,41 @@ typedef struct {
     bool has_focus;
     bool slideshow_transition;
     bool slideshow_background_rendering;
-    bool slideshow_background_ready;
     bool slideshow_paused;
     bool screensaver_active;
     bool screensaver_transition;
-    bool clock_rendering;
-    bool clock_ready;
+    bool wakeup_scheduled;
+    bool searching;
+    bool icons_loaded; // A menu finished loading its icons, the texture budget needs to be checked
 } State;
 
 // Timing information
 typedef struct {
     Uint32 main;
     Uint32 application_launched;
+    Uint32 application_detected;
     Uint32 slideshow_load;
     Uint32 last_input;
-    Uint32 clock_update;
+    Uint32 clock_update; // Deadline for the next clock update
+    Uint32 wakeup; // Earliest deadline registered with the main loop
     Uint32 application_exited;
 } Ticks;
 
+// Glyph quad copied from the glyph atlas
+typedef struct {
+    int      page;
+    SDL_Rect src;
+    SDL_Rect dst;
+} GlyphQuad;
+
+// Glyph layout of a string of text
+typedef struct {
+    GlyphQuad *quads;
+    int       num_quads;
+    int       capacity;
+    int       shadow_offset;
+} TextLayout;
+
 // Linked list for menu entries
 typedef struct entry {
     char           *title;
@@ -143,9 +167,12 @@ typedef struct entry {
     SDL_Texture    *icon;
     SDL_Texture    *icon_selected;
     SDL_Rect       icon_rect;
-    SDL_Texture    *title_texture;
+    TextLayout     title_layout;
     SDL_Rect       text_rect;
     int            title_offset;
+    bool           rendered; // Icons and title are loaded
+    unsigned int   launches; // Launches detected while collecting metrics
+    Uint64         launch_latency; // Total for those launches in microseconds
     struct entry   *next;
     struct entry   *previous;
 } Entry;
@@ -155,8 +182,13 @@ typedef struct menu {
     char         *name;
     unsigned int num_entries;
     bool         rendered;
-    unsigned int page;
+    unsigned int last_visible; // Visit count when the menu was last shown, for LRU eviction
+    unsigned int pending_icons; // Icons still being rasterized by workers
+    size_t       texture_bytes;
+    unsigned int page; // Row on top of the screen in a grid
     unsigned int highlight_position;
+    unsigned int loaded_first; // Range of entries rendered in a grid
+    unsigned int loaded_last;
     Entry        *first_entry;
     Entry        *root_entry;
     Entry        *last_selected_entry;
@@ -196,8 +228,9 @@ typedef struct {
     int screen_margin;
     int font_height;
     int x_margin; // Distance between left edge of screen and x coordinate of root_entry icon
-    int y_margin; // Distance between top edge of screen and y coordinate of all entry icons
+    int y_margin; // Distance between top edge of screen and y coordinate of the top row of icons
     int x_advance; // Distance between icon x coordinate of adjacent entries
+    int y_advance; // Distance between icon y coordinate of adjacent rows
     int num_buttons; // Number of buttons shown on the screen
 } Geometry;
 
@@ -205,8 +238,20 @@ typedef struct {
 typedef struct {
     SDL_Texture *texture;
     SDL_Rect rect;
+    float x; // Animated coordinates of rect
+    float y;
 } Highlight;
 
+// Page change animation, the page sliding out is drawn from the stale
+// geometry of its entries
+typedef struct {
+    float offset; // Horizontal offset of the current page, animated to 0
+    Entry *previous_root; // First entry of the page sliding out
+    int   previous_buttons;
+    int   direction; // 1 if the new page comes in from the right, -1 from the left
+    bool  active;
+} PageSlide;
+
 //Struct for scroll indicators
 typedef struct {
     SDL_Texture *texture;
@@ -214,24 +259,39 @@ typedef struct {
     SDL_Rect rect_left;
 } Scroll;
 
+// What is known about a slideshow image, probed from its header or
+// recorded when it was decoded
+typedef struct slideshow_image {
+    struct slideshow_image *next; // In the order found
+    Sint64 mtime;
+    Uint32 width;
+    Uint32 height;
+    Uint32 decode_time; // Milliseconds
+    int position; // Index in the shuffled image list
+    Uint8 orientation; // EXIF orientation from 1 to 8
+    Uint8 flags;
+    bool listed; // In the slideshow, false if removed or only known from the index
+    bool checked; // The metadata was verified against the file this run
+    char path[];
+} SlideshowImage;
+
 // Slideshow
 typedef struct {
-    char **images;
-    int *order;
-    int i;
-    int num_images;
+    SlideshowImage *current; // Image shown as the background
+    SlideshowImage *next; // Image in the staging frame
     float transition_alpha;
-    float transition_change_rate;
-    SDL_Surface *transition_surface;
-    SDL_Texture *transition_texture;
+    SDL_Texture *transition_texture; // Back texture while it fades in
+    SDL_Texture *textures[SLIDESHOW_TEXTURES]; // Persistent streaming textures
+    int front; // Index of the texture shown as the background
+    SDL_Surface *staging; // Screen sized frame the next image is scaled into
+    bool staged; // The worker decoded an image into the staging frame
 } Slideshow;
 
 // Screensaver
 typedef struct {
     float alpha;
     float alpha_end_value;
-    float transition_change_rate;
-    SDL_Texture *texture;
+    SDL_Color color;
 } Screensaver;
 
 // Configuration settings
@@ -241,6 +301,7 @@ typedef struct {
     bool vsync;
     int fps_limit;
     Uint32 application_timeout;
+    size_t texture_memory_limit; // Bytes, 0 for no limit
     ModeBackground background_mode; // Defines image or color background mode
     SDL_Color background_color; // Background color
     SDL_Color chroma_key_color;
@@ -271,17 +332,21 @@ typedef struct {
     int highlight_vpadding;
     int highlight_hpadding;
     char vcenter[PERCENT_MAX_CHARS];
+    unsigned int rows;
     bool scroll_indicators;
     SDL_Color scroll_indicator_fill_color;
     int scroll_indicator_outline_size;
     SDL_Color scroll_indicator_outline_color;
     char scroll_indicator_opacity[PERCENT_MAX_CHARS];
     bool wrap_entries;
+    bool animated_navigation;
     bool reset_on_back;
     bool mouse_select;
     bool inhibit_os_screensaver;
     char *startup_cmd;
     char *quit_cmd;
+    char *control_socket;
+    char *metrics_file;
     ModeOnLaunch on_launch;
     bool screensaver_enabled;
     Uint32 screensaver_idle_time;
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "metrics.h"
+#include "worker.h"
+#include "debug.h"
+
+static void init_histogram(Histogram *histogram, const char *name, const char *help, const Uint32 *bounds, int num_bounds);
+static void drain_counter(Counter *counter);
+static void append_metrics(MetricsBuffer *buffer, const char *format, ...);
+static void append_label(MetricsBuffer *buffer, const char *value);
+static void format_histogram(MetricsBuffer *buffer, Histogram *histogram);
+static void format_counter(MetricsBuffer *buffer, const char *name, const char *help, double value);
+static void format_gauge(MetricsBuffer *buffer, const char *name, const char *help, double value);
+static void format_entry_launches(MetricsBuffer *buffer);
+static void write_metrics_file(void *data);
+static void free_metrics_buffer(void *data);
+
+extern Config config;
+bool metrics_enabled = false;
+Metrics metrics = {0};
+
+// Bucket bounds in microseconds
+static const Uint32 frame_time_bounds[] = {
+    1000, 2000, 4000, 8000, 16667, 33333, 66667, 100000, 250000
+};
+static const Uint32 latency_bounds[] = {
+    10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+// A function to set up a histogram with its bucket bounds
+static void init_histogram(Histogram *histogram, const char *name, const char *help, const Uint32 *bounds, int num_bounds)
+{
+    histogram->name = name;
+    histogram->help = help;
+    histogram->bounds = bounds;
+    histogram->num_bounds = num_bounds;
+}
+
+// A function to start collecting metrics to be written to a file periodically
+void init_metrics(const char *path)
+{
+    metrics.path = strdup(path);
+    metrics.next_write = SDL_GetTicks() + METRICS_WRITE_INTERVAL;
+    init_histogram(&metrics.frame_time,
+        METRICS_PREFIX "frame_seconds",
+        "Time to draw and present a frame",
+        frame_time_bounds,
+        (int) (sizeof(frame_time_bounds) / sizeof(frame_time_bounds[0]))
+    );
+    init_histogram(&metrics.slideshow_decode,
+        METRICS_PREFIX "slideshow_decode_seconds",
+        "Time to decode the next slideshow background",
+        latency_bounds,
+        (int) (sizeof(latency_bounds) / sizeof(latency_bounds[0]))
+    );
+    init_histogram(&metrics.launch_latency,
+        METRICS_PREFIX "launch_seconds",
+        "Time from starting an application until it takes focus",
+        latency_bounds,
+        (int) (sizeof(latency_bounds) / sizeof(latency_bounds[0]))
+    );
+    metrics_enabled = true;
+}
+
+// A function to record the time since a performance counter value in a histogram
+void record_duration(Histogram *histogram, Uint64 start)
+{
+    Uint64 elapsed = (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+    record_histogram(histogram, elapsed > SDL_MAX_UINT32 ? SDL_MAX_UINT32 : (Uint32) elapsed);
+}
+
+// A function to record a duration in microseconds in a histogram, safe to
+// call from any thread. Samples are clamped to about 35 minutes so a single
+// one can't turn the delta of the sum negative
+void record_histogram(Histogram *histogram, Uint32 microseconds)
+{
+    int i = 0;
+    while (i < histogram->num_bounds && microseconds > histogram->bounds[i])
+        i++;
+    SDL_AtomicAdd(&histogram->buckets[i].delta, 1);
+    SDL_AtomicAdd(&histogram->sum.delta, microseconds > (Uint32) SDL_MAX_SINT32 ? SDL_MAX_SINT32 : (int) microseconds);
+}
+
+// A function to move the pending delta of a counter into its total. The
+// delta is reset every write, so it can't overflow in between
+static void drain_counter(Counter *counter)
+{
+    counter->total += (Uint32) SDL_AtomicSet(&counter->delta, 0);
+}
+
+// A function to append printf-style formatted text to the buffer
+static void append_metrics(MetricsBuffer *buffer, const char *format, ...)
+{
+    va_list args;
+    while (1) {
+        va_start(args, format);
+        int length = vsnprintf(buffer->text + buffer->length, buffer->size - buffer->length, format, args);
+        va_end(args);
+        if (length < 0)
+            return;
+        if (buffer->length + (size_t) length < buffer->size) {
+            buffer->length += (size_t) length;
+            return;
+        }
+        buffer->size *= 2;
+        char *text = realloc(buffer->text, buffer->size);
+        if (text == NULL)
+            log_fatal("Could not allocate metrics buffer");
+        buffer->text = text;
+    }
+}
+
+// A function to append a quoted label value, escaped as the format requires
+static void append_label(MetricsBuffer *buffer, const char *value)
+{
+    append_metrics(buffer, "\"");
+    for (const char *p = value; *p != '\0'; p++) {
+        if (*p == '\\' || *p == '"')
+            append_metrics(buffer, "\\%c", *p);
+        else if (*p == '\n')
+            append_metrics(buffer, "\\n");
+        else
+            append_metrics(buffer, "%c", *p);
+    }
+    append_metrics(buffer, "\"");
+}
+
+// A function to drain and format a histogram with cumulative buckets
+static void format_histogram(MetricsBuffer *buffer, Histogram *histogram)
+{
+    Uint64 count = 0;
+    append_metrics(buffer, "# HELP %s %s\n# TYPE %s histogram\n", histogram->name, histogram->help, histogram->name);
+    for (int i = 0; i <= histogram->num_bounds; i++) {
+        drain_counter(histogram->buckets + i);
+        count += histogram->buckets[i].total;
+        if (i < histogram->num_bounds)
+            append_metrics(buffer, "%s_bucket{le=\"%g\"} %llu\n", histogram->name, (double) histogram->bounds[i] / 1000000.0, (unsigned long long) count);
+        else
+            append_metrics(buffer, "%s_bucket{le=\"+Inf\"} %llu\n", histogram->name, (unsigned long long) count);
+    }
+    drain_counter(&histogram->sum);
+    append_metrics(buffer, "%s_sum %.6f\n", histogram->name, (double) histogram->sum.total / 1000000.0);
+    append_metrics(buffer, "%s_count %llu\n", histogram->name, (unsigned long long) count);
+}
+
+// A function to format a counter
+static void format_counter(MetricsBuffer *buffer, const char *name, const char *help, double value)
+{
+    append_metrics(buffer, "# HELP %s %s\n# TYPE %s counter\n%s %.17g\n", name, help, name, name, value);
+}
+
+// A function to format a gauge
+static void format_gauge(MetricsBuffer *buffer, const char *name, const char *help, double value)
+{
+    append_metrics(buffer, "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, value);
+}
+
+// A function to format the launch latency of every entry that has been launched
+static void format_entry_launches(MetricsBuffer *buffer)
+{
+    const char *name = METRICS_PREFIX "entry_launch_seconds";
+    append_metrics(buffer, "# HELP %s Time from starting an entry's application until it takes focus\n", name);
+    append_metrics(buffer, "# TYPE %s summary\n", name);
+    for (Menu *menu = config.first_menu; menu != NULL; menu = menu->next) {
+        for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next) {
+            if (!entry->launches)
+                continue;
+            for (int i = 0; i < 2; i++) {
+                append_metrics(buffer, "%s_%s{menu=", name, i ? "count" : "sum");
+                append_label(buffer, menu->name);
+                append_metrics(buffer, ",entry=");
+                append_label(buffer, entry->title != NULL ? entry->title : "");
+                if (i)
+                    append_metrics(buffer, "} %u\n", entry->launches);
+                else
+                    append_metrics(buffer, "} %.6f\n", (double) entry->launch_latency / 1000000.0);
+            }
+        }
+    }
+}
+
+// A function to write the formatted metrics to a temporary file and move
+// it over the metrics file, so readers never see a partial file
+static void write_metrics_file(void *data)
+{
+    MetricsBuffer *buffer = (MetricsBuffer*) data;
+    size_t length = strlen(metrics.path) + sizeof(".tmp");
+    char *tmp_path = malloc(length);
+    snprintf(tmp_path, length, "%s.tmp", metrics.path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+        log_error("Could not open metrics file '%s'", tmp_path);
+    else {
+        bool written = fwrite(buffer->text, 1, buffer->length, file) == buffer->length;
+        written = !fclose(file) && written;
+
+        // Windows can't rename over an existing file
+        if (written && rename(tmp_path, metrics.path)) {
+            remove(metrics.path);
+            written = !rename(tmp_path, metrics.path);
+        }
+        if (!written) {
+            log_error("Could not write metrics file '%s'", metrics.path);
+            remove(tmp_path);
+        }
+    }
+    free(tmp_path);
+}
+
+// A function to free the formatted metrics once they have been written
+static void free_metrics_buffer(void *data)
+{
+    MetricsBuffer *buffer = (MetricsBuffer*) data;
+    free(buffer->text);
+    free(buffer);
+}
+
+// A function to format the metrics when the write interval has passed and
+// write them to the file on a worker thread
+void update_metrics(Uint32 now)
+{
+    if (!SDL_TICKS_PASSED(now, metrics.next_write))
+        return;
+    metrics.next_write = now + METRICS_WRITE_INTERVAL;
+
+    // Gauges are read from menu state owned by the main thread
+    unsigned int rendered_menus = 0;
+    size_t texture_bytes = 0;
+    for (Menu *menu = config.first_menu; menu != NULL; menu = menu->next) {
+        if (menu->rendered)
+            rendered_menus++;
+        texture_bytes += menu->texture_bytes;
+    }
+
+    MetricsBuffer *buffer = malloc(sizeof(MetricsBuffer));
+    *buffer = (MetricsBuffer) {
+        .text = malloc(METRICS_BUFFER_SIZE),
+        .length = 0,
+        .size = METRICS_BUFFER_SIZE
+    };
+    if (buffer->text == NULL)
+        log_fatal("Could not allocate metrics buffer");
+    format_histogram(buffer, &metrics.frame_time);
+    format_histogram(buffer, &metrics.slideshow_decode);
+    format_histogram(buffer, &metrics.launch_latency);
+    format_entry_launches(buffer);
+    format_gauge(buffer,
+        METRICS_PREFIX "texture_bytes",
+        "Texture memory used by menu icons and titles",
+        (double) texture_bytes
+    );
+    format_gauge(buffer,
+        METRICS_PREFIX "rendered_menus",
+        "Menus with their textures loaded",
+        (double) rendered_menus
+    );
+    drain_counter(&metrics.clock_renders);
+    format_counter(buffer,
+        METRICS_PREFIX "clock_renders_total",
+        "Times the clock text was laid out",
+        (double) metrics.clock_renders.total
+    );
+    drain_counter(&metrics.applications_finished);
+    format_counter(buffer,
+        METRICS_PREFIX "applications_finished_total",
+        "Launched applications that have exited",
+        (double) metrics.applications_finished.total
+    );
+    drain_counter(&metrics.application_wait);
+    format_counter(buffer,
+        METRICS_PREFIX "application_wait_seconds_total",
+        "Time spent waiting for launched applications to exit",
+        (double) metrics.application_wait.total / 1000.0
+    );
+    drain_counter(&metrics.log_bytes);
+    format_counter(buffer,
+        METRICS_PREFIX "log_bytes_total",
+        "Bytes written to the log file",
+        (double) metrics.log_bytes.total
+    );
+    if (!submit_job(write_metrics_file, free_metrics_buffer, buffer)) {
+        write_metrics_file(buffer);
+        free_metrics_buffer(buffer);
+    }
+}
+
+// A function to stop collecting metrics, must be called after the worker
+// threads have stopped
+void quit_metrics()
+{
+    metrics_enabled = false;
+    free(metrics.path);
+    metrics.path = NULL;
+}
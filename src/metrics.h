@@ -0,0 +1,55 @@
+#define METRICS_WRITE_INTERVAL 15000
+#define METRICS_MAX_BUCKETS 12
+#define METRICS_PREFIX "flex_launcher_"
+#define METRICS_BUFFER_SIZE 4096
+
+// Monotonic counter. Any thread adds to the delta without locking, the
+// main thread drains it into the total when the metrics are written
+typedef struct {
+    SDL_atomic_t delta;
+    Uint64       total;
+} Counter;
+
+// Latency histogram with fixed bucket bounds, updated the same way as a counter
+typedef struct {
+    const char   *name;
+    const char   *help;
+    const Uint32 *bounds; // Upper bounds of the buckets in microseconds
+    int          num_bounds;
+    Counter      buckets[METRICS_MAX_BUCKETS + 1]; // The last bucket is +Inf
+    Counter      sum; // Microseconds, samples are clamped to fit the delta
+} Histogram;
+
+// Runtime performance counters written periodically in Prometheus text format
+typedef struct {
+    char      *path;
+    Uint32    next_write;
+    Histogram frame_time;
+    Histogram slideshow_decode;
+    Histogram launch_latency;
+    Counter   clock_renders;
+    Counter   applications_finished;
+    Counter   application_wait; // Milliseconds
+    Counter   log_bytes;
+} Metrics;
+
+// Growable text buffer for formatting the metrics file
+typedef struct {
+    char   *text;
+    size_t length;
+    size_t size;
+} MetricsBuffer;
+
+extern bool metrics_enabled;
+extern Metrics metrics;
+
+// Hot path macros, the counter read and atomic add are skipped when metrics are off
+#define METRICS_START() (metrics_enabled ? SDL_GetPerformanceCounter() : 0)
+#define RECORD_DURATION(histogram, start) do { if (metrics_enabled) record_duration(&metrics.histogram, start); } while (0)
+#define ADD_COUNTER(counter, value) do { if (metrics_enabled) SDL_AtomicAdd(&metrics.counter.delta, (int) (value)); } while (0)
+
+void init_metrics(const char *path);
+void record_duration(Histogram *histogram, Uint64 start);
+void record_histogram(Histogram *histogram, Uint32 microseconds);
+void update_metrics(Uint32 now);
+void quit_metrics(void);
@@ -4,11 +4,18 @@
 #define FILE_MODE_WRITE "w"
 #endif
 
+// Called for every file of a cache directory with its size and modification time
+typedef void (*CacheFileHandler)(const char *path, Sint64 size, Sint64 mtime);
+
 // Abstracted platform function prototypes
 bool file_exists(const char *path);
 bool directory_exists(const char *path);
+Sint64 get_modification_time(const char *path);
 void get_region(char *buffer);
-void scan_slideshow_directory(Slideshow *slideshow, const char *directory);
+bool get_cache_directory(char *buffer, size_t bytes);
+void scan_cache_directory(const char *directory, const char *extension, CacheFileHandler handler);
+void touch_file(const char *path);
+void scan_slideshow_directory(const char *directory);
 bool start_process(char *cmd, bool application);
 bool process_running();
 void scmd_shutdown(void);
@@ -19,6 +26,10 @@ void scmd_sleep(void);
 #ifdef __unix__
 void make_directory(const char *directory);
 void print_usage(void);
+void init_slideshow_watch(void);
+void watch_slideshow_directory(void);
+void stop_slideshow_watch(void);
+void quit_slideshow_watch(void);
 #endif
 
 // Windows-specific function prototypes
@@ -4,6 +4,11 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/inotify.h>
+#include <utime.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <signal.h>
 #include <SDL.h>
 #include "../external/ini.h"
@@ -11,6 +16,8 @@
 #include <launcher_config.h>
 #include "unix.h"
 #include "../util.h"
+#include "../arena.h"
+#include "../scanner.h"
 #include "../debug.h"
 #include "platform.h"
 #include "slideshow.h"
@@ -18,9 +25,15 @@
 static int desktop_handler(void *user, const char *section, const char *name, const char *value);
 static void strip_field_codes(char *cmd);
 static bool ends_with(const char *string, const char *phrase);
-static int image_filter(const struct dirent *file);
+static bool is_image_file(const char *file);
+static bool scan_directory(const char *directory);
+static void add_directory_watch(const char *directory);
+static DirectoryWatch *find_directory_watch(int wd);
+static void remove_directory_watches(const char *directory);
+static void handle_watch_event(const struct inotify_event *event);
 
 pid_t child_pid;
+static SlideshowWatch watch = {.fd = -1, .wake_fd = {-1, -1}};
 
 // A function to handle .desktop lines
 static int desktop_handler(void *user, const char *section, const char *name, const char *value)
@@ -44,6 +57,16 @@ bool directory_exists(const char *path)
     return stat(path, &directory) == 0 && S_ISDIR(directory.st_mode) ? true : false;
 }
 
+// A function to get the last modification time of a file, returns -1 if
+// the file doesn't exist
+Sint64 get_modification_time(const char *path)
+{
+    struct stat file;
+    if (stat(path, &file))
+        return -1;
+    return (Sint64) file.st_mtime;
+}
+
 // A function to remove field codes from .desktop file Exec line
 static void strip_field_codes(char *cmd)
 {
@@ -185,45 +208,282 @@ bool process_running()
 }
 
 // A function to determine if a file is an image file
-int image_filter(const struct dirent *file)
+static bool is_image_file(const char *file)
 {
-    size_t len_file = strlen(file->d_name);
-    size_t len_extension;
     for (size_t i = 0; i < NUM_IMAGE_EXTENSIONS; i++) {
-        len_extension = strlen(extensions[i]);
-        if (len_file > len_extension && 
-        !strcmp(file->d_name + len_file - len_extension, extensions[i]))
-            return 1;
+        if (strlen(file) > strlen(extensions[i]) && ends_with(file, extensions[i]))
+            return true;
+    }
+    return false;
+}
+
+// A function to add every image of a directory and its subdirectories to
+// the slideshow, returns false if the scanner is quitting. Hidden entries
+// and symbolic links to directories are skipped, so links can't loop
+static bool scan_directory(const char *directory)
+{
+    add_directory_watch(directory);
+    DIR *dir = opendir(directory);
+    if (dir == NULL)
+        return true;
+    char path[MAX_PATH_CHARS + 1];
+    struct dirent *file;
+    struct stat st;
+    bool scanning = true;
+    while (scanning && (file = readdir(dir)) != NULL) {
+        if (file->d_name[0] == '.')
+            continue;
+        join_paths(path, sizeof(path), 2, directory, file->d_name);
+        bool is_directory = file->d_type == DT_DIR;
+        if (file->d_type == DT_UNKNOWN)
+            is_directory = !lstat(path, &st) && S_ISDIR(st.st_mode);
+        if (is_directory)
+            scanning = scan_directory(path);
+        else if (is_image_file(file->d_name))
+            scanning = add_slideshow_image(path);
+    }
+    closedir(dir);
+    return scanning;
+}
+
+// A function to scan the slideshow directory tree for images, images are
+// added one at a time so the slideshow can start before the scan finishes
+void scan_slideshow_directory(const char *directory)
+{
+    scan_directory(directory);
+}
+
+// A function to prepare watching the slideshow directory tree for changes
+void init_slideshow_watch()
+{
+    watch.fd = inotify_init1(IN_CLOEXEC);
+    if (watch.fd < 0 || pipe(watch.wake_fd)) {
+        log_error("Could not watch slideshow directory for changes\n%s", strerror(errno));
+        quit_slideshow_watch();
+        return;
+    }
+
+    // Don't leak the pipe into launched applications
+    for (int i = 0; i < 2; i++)
+        fcntl(watch.wake_fd[i], F_SETFD, FD_CLOEXEC);
+}
+
+// A function to watch a directory of the slideshow tree, called before it
+// is read so no image added in the meantime is missed
+static void add_directory_watch(const char *directory)
+{
+    if (watch.fd < 0)
+        return;
+    int wd = inotify_add_watch(watch.fd,
+                 directory,
+                 IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM | IN_MOVE_SELF | IN_ONLYDIR
+             );
+    if (wd < 0) {
+        log_error("Could not watch slideshow directory %s\n%s", directory, strerror(errno));
+        return;
+    }
+    if (find_directory_watch(wd) != NULL)
+        return;
+    if (watch.num_watches == watch.capacity) {
+        int capacity = watch.capacity ? 2 * watch.capacity : 16;
+        DirectoryWatch *watches = realloc(watch.watches, (size_t) capacity * sizeof(DirectoryWatch));
+        if (watches == NULL)
+            log_fatal("Could not allocate slideshow directory watches");
+        watch.watches = watches;
+        watch.capacity = capacity;
+    }
+    watch.watches[watch.num_watches++] = (DirectoryWatch) {
+        .wd = wd,
+        .path = strdup(directory)
+    };
+}
+
+// A function to find the directory of a watch descriptor
+static DirectoryWatch *find_directory_watch(int wd)
+{
+    for (int i = 0; i < watch.num_watches; i++) {
+        if (watch.watches[i].wd == wd)
+            return watch.watches + i;
+    }
+    return NULL;
+}
+
+// A function to stop watching a directory and the directories under it
+static void remove_directory_watches(const char *directory)
+{
+    size_t length = strlen(directory);
+    for (int i = watch.num_watches - 1; i >= 0; i--) {
+        const char *path = watch.watches[i].path;
+        if (strncmp(path, directory, length) || (path[length] != '\0' && path[length] != '/'))
+            continue;
+        inotify_rm_watch(watch.fd, watch.watches[i].wd);
+        free(watch.watches[i].path);
+        watch.watches[i] = watch.watches[--watch.num_watches];
+    }
+}
+
+// A function to add or remove slideshow images for a change in a watched directory
+static void handle_watch_event(const struct inotify_event *event)
+{
+    if (event->mask & IN_Q_OVERFLOW) {
+        log_error("Missed changes to the slideshow directory");
+        return;
+    }
+    DirectoryWatch *directory = find_directory_watch(event->wd);
+    if (directory == NULL)
+        return;
+
+    // The directory was deleted
+    if (event->mask & IN_IGNORED) {
+        free(directory->path);
+        *directory = watch.watches[--watch.num_watches];
+        return;
+    }
+
+    // The directory was moved, its images and watches have stale paths.
+    // A new location inside the tree is scanned again by its parent's event
+    char path[MAX_PATH_CHARS + 1];
+    if (event->mask & IN_MOVE_SELF) {
+        copy_string(path, directory->path, sizeof(path));
+        remove_slideshow_directory(path);
+        remove_directory_watches(path);
+        return;
+    }
+    if (!event->len || event->name[0] == '.')
+        return;
+    join_paths(path, sizeof(path), 2, directory->path, event->name);
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+            scan_directory(path);
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            remove_slideshow_directory(path);
+            remove_directory_watches(path);
+        }
+    }
+
+    // Images are added once they are completely written
+    else if (is_image_file(event->name)) {
+        if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            add_slideshow_image(path);
+        else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+            remove_slideshow_image(path);
     }
-    return 0;
 }
 
-// A function to scan a directory for images
-void scan_slideshow_directory(Slideshow *slideshow, const char *directory)
+// A function to keep the slideshow in sync with its directory tree until
+// stop_slideshow_watch() is called
+void watch_slideshow_directory()
 {
-    struct dirent **files;
-    slideshow->num_images = scandir(directory, &files, image_filter, NULL);
-    slideshow->images = malloc((size_t) slideshow->num_images * sizeof(char*));
-    char file_path[MAX_PATH_CHARS + 1];
-    for (int i = 0; i < slideshow->num_images; i++) {
-        join_paths(file_path, sizeof(file_path), 2, directory, files[i]->d_name);
-        slideshow->images[i] = strdup(file_path);
-        free(files[i]);
+    if (watch.fd < 0)
+        return;
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        {.fd = watch.fd, .events = POLLIN},
+        {.fd = watch.wake_fd[0], .events = POLLIN}
+    };
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+        ssize_t length = read(watch.fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length <= 0)
+            return;
+        const struct inotify_event *event;
+        for (char *p = buffer; p < buffer + length; p += sizeof(struct inotify_event) + event->len) {
+            event = (const struct inotify_event*) p;
+            handle_watch_event(event);
+        }
+        verify_slideshow_images();
     }
-    free(files);
+}
+
+// A function to wake the scanner thread so it stops watching
+void stop_slideshow_watch()
+{
+    if (watch.wake_fd[1] >= 0) {
+        char byte = 0;
+        ssize_t written = write(watch.wake_fd[1], &byte, 1);
+        UNUSED(written);
+    }
+}
+
+// A function to close the watches once the scanner thread has stopped
+void quit_slideshow_watch()
+{
+    if (watch.fd >= 0)
+        close(watch.fd);
+    for (int i = 0; i < 2; i++) {
+        if (watch.wake_fd[i] >= 0)
+            close(watch.wake_fd[i]);
+    }
+    for (int i = 0; i < watch.num_watches; i++)
+        free(watch.watches[i].path);
+    free(watch.watches);
+    watch = (SlideshowWatch) {.fd = -1, .wake_fd = {-1, -1}};
 }
 
 void get_region(char *buffer)
 {
-    char *lang = getenv("LANG");
-    char *token = strtok(lang, "_");
+    // Parse a copy of the variable, e.g. "en_US.UTF-8", without modifying the environment
+    const char *lang = getenv("LANG");
+    if (lang == NULL)
+        return;
+    char lang_buffer[LANG_MAX_CHARS + 1];
+    copy_string(lang_buffer, lang, sizeof(lang_buffer));
+    char *token = strchr(lang_buffer, '_');
     if (token == NULL)
         return;
-    token = strtok(NULL, ".");
-    if (token != NULL && strlen(token) == 2)
+    token++;
+    token[strcspn(token, ".@")] = '\0';
+    if (strlen(token) == 2)
         copy_string(buffer, token, 3);
 }
 
+// A function to get the directory for cached files, creating it if needed
+bool get_cache_directory(char *buffer, size_t bytes)
+{
+    const char *xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home != NULL && *xdg_cache_home != '\0')
+        join_paths(buffer, bytes, 2, xdg_cache_home, EXECUTABLE_TITLE);
+    else if (getenv("HOME") != NULL)
+        join_paths(buffer, bytes, 3, getenv("HOME"), ".cache", EXECUTABLE_TITLE);
+    else
+        return false;
+    make_directory(buffer);
+    return directory_exists(buffer);
+}
+
+// A function to list the files of a cache directory with an extension
+void scan_cache_directory(const char *directory, const char *extension, CacheFileHandler handler)
+{
+    DIR *dir = opendir(directory);
+    if (dir == NULL)
+        return;
+    char path[MAX_PATH_CHARS + 1];
+    struct dirent *file;
+    struct stat st;
+    while ((file = readdir(dir)) != NULL) {
+        if (!ends_with(file->d_name, extension))
+            continue;
+        join_paths(path, sizeof(path), 2, directory, file->d_name);
+        if (!stat(path, &st) && S_ISREG(st.st_mode))
+            handler(path, (Sint64) st.st_size, (Sint64) st.st_mtime);
+    }
+    closedir(dir);
+}
+
+// A function to set the modification time of a file to now
+void touch_file(const char *path)
+{
+    utime(path, NULL);
+}
+
 // A function to shutdown the computer
 void scmd_shutdown()
 {
@@ -249,5 +509,6 @@ void print_usage()
     printf("  -c p, --config=p   Load config file from path p.\n");
     printf("  -d,   --debug      Enable debug messages.\n");
     printf("  -h,   --help       Show this help message.\n");
+    printf("  -t p, --trace=p    Write a performance trace to path p.\n");
     printf("  -v,   --version    Print version information.\n");
 }
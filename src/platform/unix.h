@@ -9,8 +9,24 @@
 #define DESKTOP_SECTION_HEADER_ACTION "Desktop Action %s"
 #define KEY_EXEC "Exec"
 #define MAX_INI_SECTION 100
+#define LANG_MAX_CHARS 64
 
 typedef struct {
     char section[MAX_INI_SECTION + 1];
     char *exec;
 } Desktop;
+
+// Inotify watch on one directory of the slideshow tree
+typedef struct {
+    int  wd;
+    char *path;
+} DirectoryWatch;
+
+// Watches that keep the slideshow in sync with its directory tree
+typedef struct {
+    int            fd;
+    int            wake_fd[2]; // Pipe written to stop the scanner thread
+    DirectoryWatch *watches;
+    int            num_watches;
+    int            capacity;
+} SlideshowWatch;
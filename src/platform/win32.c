@@ -11,6 +11,8 @@
 #include <launcher_config.h>
 #include "platform.h"
 #include "../util.h"
+#include "../arena.h"
+#include "../scanner.h"
 #include "../debug.h"
 #include "slideshow.h"
 
@@ -20,6 +22,8 @@ static bool process_running_name(const char *target_process);
 static bool is_browser(const char *exe_basename);
 static UINT sdl_to_win32_keycode(SDL_Keycode keycode);
 static bool get_shutdown_privilege(void);
+static bool is_image_file(const char *file);
+static bool scan_directory(const char *directory);
 
 extern Config config;
 extern SDL_SysWMinfo wm_info;
@@ -48,6 +52,16 @@ bool directory_exists(const char *path)
     }
 }
 
+// A function to get the last modification time of a file, returns -1 if
+// the file doesn't exist
+Sint64 get_modification_time(const char *path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return -1;
+    return (Sint64) ((Uint64) data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime);
+}
+
 // A function that parses the command string into a file and parameters
 static void parse_command(char *cmd, char *file, size_t file_size, char **params)
 {
@@ -187,32 +201,56 @@ bool process_running()
     return status == WAIT_OBJECT_0 ? false : true;
 }
 
-// A function to scan the slideshow directory for image files
-void scan_slideshow_directory(Slideshow *slideshow, const char *directory)
+// A function to determine if a file is an image file
+static bool is_image_file(const char *file)
+{
+    size_t len_file = strlen(file);
+    for (size_t i = 0; i < NUM_IMAGE_EXTENSIONS; i++) {
+        size_t len_extension = strlen(extensions[i]);
+        if (len_file > len_extension && !_stricmp(file + len_file - len_extension, extensions[i]))
+            return true;
+    }
+    return false;
+}
+
+// A function to add every image of a directory and its subdirectories to
+// the slideshow, returns false if the scanner is quitting. Hidden entries
+// and reparse points such as directory junctions are skipped, so links can't loop
+static bool scan_directory(const char *directory)
 {
     WIN32_FIND_DATAA data;
-    HANDLE handle;
-    char file_search[MAX_PATH_CHARS + 1];
-    char file_output[MAX_PATH_CHARS + 1];
-    char extension[10];
-
-    // Generate a wildcard file search string for all supported image file extensions
-    for (int i = 0; i < NUM_IMAGE_EXTENSIONS; i++) {
-        copy_string(extension, "*", sizeof(extension));
-        strcat(extension, extensions[i]);
-        join_paths(file_search, sizeof(file_search), 2, directory, extension);
-
-        // Store every result into the slideshow struct
-        handle = FindFirstFileA(file_search, &data);
-        if (handle != INVALID_HANDLE_VALUE) {
-            do {
-                join_paths(file_output, sizeof(file_output), 2, directory, data.cFileName);
-                slideshow->images = realloc(slideshow->images, (slideshow->num_images + 1) * sizeof(char*));
-                slideshow->images[slideshow->num_images] = strdup(file_output);
-                slideshow->num_images++;
-            } while (FindNextFileA(handle, &data) != 0);
+    char path[MAX_PATH_CHARS + 1];
+    join_paths(path, sizeof(path), 2, directory, "*");
+    HANDLE handle = FindFirstFileExA(path, 
+                        FindExInfoBasic, 
+                        &data, 
+                        FindExSearchNameMatch, 
+                        NULL, 
+                        FIND_FIRST_EX_LARGE_FETCH
+                    );
+    if (handle == INVALID_HANDLE_VALUE)
+        return true;
+    bool scanning = true;
+    do {
+        if (data.cFileName[0] == '.' || data.dwFileAttributes & FILE_ATTRIBUTE_HIDDEN)
+            continue;
+        join_paths(path, sizeof(path), 2, directory, data.cFileName);
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                scanning = scan_directory(path);
         }
-    }
+        else if (is_image_file(data.cFileName))
+            scanning = add_slideshow_image(path);
+    } while (scanning && FindNextFileA(handle, &data) != 0);
+    FindClose(handle);
+    return scanning;
+}
+
+// A function to scan the slideshow directory tree for images, images are
+// added one at a time so the slideshow can start before the scan finishes
+void scan_slideshow_directory(const char *directory)
+{
+    scan_directory(directory);
 }
 
 // A function to get the 2 letter region code
@@ -222,6 +260,62 @@ void get_region(char *buffer)
     GetGeoInfoA(geo_id, GEO_ISO2, buffer, 3, 0);
 }
 
+// A function to get the directory for cached files, creating it if needed
+bool get_cache_directory(char *buffer, size_t bytes)
+{
+    join_paths(buffer, bytes, 2, config.exe_path, PATH_CACHE_EXE);
+    CreateDirectoryA(buffer, NULL);
+    return directory_exists(buffer);
+}
+
+// A function to list the files of a cache directory with an extension
+void scan_cache_directory(const char *directory, const char *extension, CacheFileHandler handler)
+{
+    WIN32_FIND_DATAA data;
+    char path[MAX_PATH_CHARS + 1];
+    char pattern[MAX_PATH_CHARS + 1];
+    snprintf(pattern, sizeof(pattern), "*%s", extension);
+    join_paths(path, sizeof(path), 2, directory, pattern);
+    HANDLE handle = FindFirstFileExA(path, 
+                        FindExInfoBasic, 
+                        &data, 
+                        FindExSearchNameMatch, 
+                        NULL, 
+                        FIND_FIRST_EX_LARGE_FETCH
+                    );
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        join_paths(path, sizeof(path), 2, directory, data.cFileName);
+        handler(path,
+            (Sint64) ((Uint64) data.nFileSizeHigh << 32 | data.nFileSizeLow),
+            (Sint64) ((Uint64) data.ftLastWriteTime.dwHighDateTime << 32 | data.ftLastWriteTime.dwLowDateTime)
+        );
+    } while (FindNextFileA(handle, &data) != 0);
+    FindClose(handle);
+}
+
+// A function to set the modification time of a file to now
+void touch_file(const char *path)
+{
+    HANDLE file = CreateFileA(path,
+                      FILE_WRITE_ATTRIBUTES,
+                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                      NULL,
+                      OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL,
+                      NULL
+                  );
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+}
+
 // A function to shutdown the computer
 void scmd_shutdown()
 {
@@ -0,0 +1,635 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "util.h"
+#include "arena.h"
+#include "scanner.h"
+#include "debug.h"
+#include "platform/platform.h"
+
+static int scanner_thread(void *data);
+static void finish_scan(void);
+static SlideshowImage *find_image(const char *path, bool create);
+static void grow_image_table(void);
+static void place_image(SlideshowImage *image, int i);
+static void unlist_image(SlideshowImage *image);
+static void read_slideshow_index(void);
+static void write_slideshow_index(void);
+static Uint32 read_uint16(const Uint8 *p, bool little_endian);
+static Uint32 read_uint32(const Uint8 *p, bool little_endian);
+static Uint8 read_exif_orientation(const Uint8 *tiff, size_t size);
+static bool probe_jpeg(FILE *file, Uint32 *width, Uint32 *height, Uint8 *orientation);
+static bool probe_image(const char *path, Uint32 *width, Uint32 *height, Uint8 *orientation);
+static bool is_cheaper(const SlideshowImage *a, const SlideshowImage *b);
+static int random_index(int size);
+
+extern Config config;
+static ImageScanner scanner = {0};
+
+// A function to start scanning a directory tree for slideshow images in
+// the background. The tree is scanned synchronously if the thread can't start
+int init_scanner(const char *directory)
+{
+    srand((unsigned int) time(NULL));
+    scanner.mutex = SDL_CreateMutex();
+    scanner.cond = SDL_CreateCond();
+    if (scanner.mutex == NULL || scanner.cond == NULL) {
+        log_error("Could not create slideshow scanner\n%s", SDL_GetError());
+        return 1;
+    }
+
+    // Metadata of previously seen images is kept in the cache directory
+    char cache_directory[MAX_PATH_CHARS + 1];
+    if (get_cache_directory(cache_directory, sizeof(cache_directory)))
+        join_paths(scanner.index_path, sizeof(scanner.index_path), 2, cache_directory, SLIDESHOW_INDEX_FILENAME);
+#ifdef __unix__
+    init_slideshow_watch();
+#endif
+    scanner.thread = SDL_CreateThread(scanner_thread, SCANNER_THREAD_NAME, (void*) directory);
+    if (scanner.thread == NULL) {
+        log_error("Could not start slideshow scanner thread\n%s", SDL_GetError());
+        read_slideshow_index();
+        scan_slideshow_directory(directory);
+        finish_scan();
+    }
+    return 0;
+}
+
+// A function to stop the scanner thread, save the metadata index and free
+// the image records
+void quit_scanner()
+{
+    if (scanner.mutex != NULL) {
+        SDL_LockMutex(scanner.mutex);
+        scanner.quit = true;
+        SDL_CondBroadcast(scanner.cond);
+        SDL_UnlockMutex(scanner.mutex);
+    }
+#ifdef __unix__
+    stop_slideshow_watch();
+#endif
+    if (scanner.thread != NULL)
+        SDL_WaitThread(scanner.thread, NULL);
+#ifdef __unix__
+    quit_slideshow_watch();
+#endif
+
+    // Images not found by an unfinished scan would be dropped from the index
+    if (scanner.scanned && scanner.dirty)
+        write_slideshow_index();
+    SDL_DestroyCond(scanner.cond);
+    SDL_DestroyMutex(scanner.mutex);
+    free(scanner.images);
+    free(scanner.table);
+    free_arena(&scanner.arena);
+    scanner = (ImageScanner) {0};
+}
+
+// A function to scan the slideshow directory tree and verify the images,
+// then keep it watched for added and removed images until the scanner quits
+static int scanner_thread(void *data)
+{
+    read_slideshow_index();
+    scan_slideshow_directory((const char*) data);
+    finish_scan();
+    verify_slideshow_images();
+#ifdef __unix__
+    watch_slideshow_directory();
+#endif
+    return 0;
+}
+
+// A function to mark the scan of the directory tree as complete
+static void finish_scan()
+{
+    SDL_LockMutex(scanner.mutex);
+    scanner.scanned = !scanner.quit;
+    SDL_CondBroadcast(scanner.cond);
+    if (config.debug)
+        debug_slideshow(scanner.images, scanner.num_images);
+    SDL_UnlockMutex(scanner.mutex);
+}
+
+// A function to find the record of an image by path, optionally creating it
+static SlideshowImage *find_image(const char *path, bool create)
+{
+    // Keep the table at most half full
+    if (2 * (scanner.num_records + 1) > scanner.table_capacity)
+        grow_image_table();
+    Uint32 i = hash_string(path) & (scanner.table_capacity - 1);
+    while (scanner.table[i] != NULL) {
+        if (MATCH(scanner.table[i]->path, path))
+            return scanner.table[i];
+        i = (i + 1) & (scanner.table_capacity - 1);
+    }
+    if (!create)
+        return NULL;
+
+    // Records are packed into the arena with the path stored inline
+    size_t length = strlen(path) + 1;
+    SlideshowImage *image = arena_alloc(&scanner.arena, sizeof(SlideshowImage) + length);
+    *image = (SlideshowImage) {
+        .next = NULL,
+        .mtime = -1,
+        .orientation = 1,
+        .position = -1
+    };
+    memcpy(image->path, path, length);
+    if (scanner.last_record == NULL)
+        scanner.first_record = image;
+    else
+        scanner.last_record->next = image;
+    scanner.last_record = image;
+    scanner.table[i] = image;
+    scanner.num_records++;
+    return image;
+}
+
+// A function to double the size of the image table
+static void grow_image_table()
+{
+    Uint32 capacity = scanner.table_capacity ? 2 * scanner.table_capacity : IMAGE_TABLE_MIN_SIZE;
+    SlideshowImage **table = calloc(capacity, sizeof(SlideshowImage*));
+    if (table == NULL)
+        log_fatal("Could not allocate slideshow image table");
+    for (Uint32 i = 0; i < scanner.table_capacity; i++) {
+        if (scanner.table[i] == NULL)
+            continue;
+        Uint32 j = hash_string(scanner.table[i]->path) & (capacity - 1);
+        while (table[j] != NULL)
+            j = (j + 1) & (capacity - 1);
+        table[j] = scanner.table[i];
+    }
+    free(scanner.table);
+    scanner.table = table;
+    scanner.table_capacity = capacity;
+}
+
+// A function to put an image at a position of the shuffled list
+static void place_image(SlideshowImage *image, int i)
+{
+    scanner.images[i] = image;
+    image->position = i;
+}
+
+// A function to add an image to the slideshow, returns false if the
+// scanner is quitting and scanning should stop
+bool add_slideshow_image(const char *path)
+{
+    SDL_LockMutex(scanner.mutex);
+    if (scanner.quit) {
+        SDL_UnlockMutex(scanner.mutex);
+        return false;
+    }
+    SlideshowImage *image = find_image(path, true);
+
+    // An image reported again was rewritten, verify it against the file again
+    if (image->listed) {
+        if (image->checked) {
+            image->checked = false;
+            scanner.num_unchecked++;
+        }
+        SDL_UnlockMutex(scanner.mutex);
+        return true;
+    }
+    if (scanner.num_images == scanner.capacity) {
+        int capacity = scanner.capacity ? 2 * scanner.capacity : SCANNER_MIN_IMAGES;
+        SlideshowImage **images = realloc(scanner.images, (size_t) capacity * sizeof(SlideshowImage*));
+        if (images == NULL)
+            log_fatal("Could not allocate slideshow image list");
+        scanner.images = images;
+        scanner.capacity = capacity;
+    }
+
+    // New images land after the shown ones, so they come up in the current cycle
+    image->listed = true;
+    image->checked = false;
+    scanner.num_unchecked++;
+    place_image(image, scanner.num_images++);
+    if (scanner.num_images == 1)
+        SDL_CondBroadcast(scanner.cond);
+    SDL_UnlockMutex(scanner.mutex);
+    return true;
+}
+
+// A function to take an image out of the list, the images moved into its
+// place come from later positions
+static void unlist_image(SlideshowImage *image)
+{
+    int i = image->position;
+
+    // Fill the gap without moving images between the shown and unshown parts
+    if (i < scanner.num_shown) {
+        scanner.num_shown--;
+        place_image(scanner.images[scanner.num_shown], i);
+        i = scanner.num_shown;
+    }
+    scanner.num_images--;
+    place_image(scanner.images[scanner.num_images], i);
+    if (!image->checked)
+        scanner.num_unchecked--;
+    image->listed = false;
+    image->position = -1;
+}
+
+// A function to remove an image that was deleted from the slideshow directory
+void remove_slideshow_image(const char *path)
+{
+    SDL_LockMutex(scanner.mutex);
+    SlideshowImage *image = find_image(path, false);
+    if (image != NULL && image->listed)
+        unlist_image(image);
+    SDL_UnlockMutex(scanner.mutex);
+}
+
+// A function to remove the images under a directory that was deleted from
+// or moved out of the slideshow directory tree
+void remove_slideshow_directory(const char *directory)
+{
+    size_t length = strlen(directory);
+    SDL_LockMutex(scanner.mutex);
+
+    // Walk backwards, so every image moved into a gap was already checked
+    for (int i = scanner.num_images - 1; i >= 0; i--) {
+        const char *path = scanner.images[i]->path;
+        if (!strncmp(path, directory, length) && path[length] == PATH_SEPARATOR[0])
+            unlist_image(scanner.images[i]);
+    }
+    SDL_UnlockMutex(scanner.mutex);
+}
+
+// A function to read the metadata of previously seen images from the index
+static void read_slideshow_index()
+{
+    if (scanner.index_path[0] == '\0')
+        return;
+    FILE *file = fopen(scanner.index_path, "rb");
+    if (file == NULL)
+        return;
+    SlideshowIndexHeader header;
+    SlideshowIndexEntry entry;
+    char path[MAX_PATH_CHARS + 1];
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+    header.magic == SLIDESHOW_INDEX_MAGIC &&
+    header.version == SLIDESHOW_INDEX_VERSION) {
+        SDL_LockMutex(scanner.mutex);
+        for (Uint32 i = 0; i < header.num_entries; i++) {
+            if (fread(&entry, sizeof(entry), 1, file) != 1 ||
+            entry.path_length > MAX_PATH_CHARS ||
+            fread(path, 1, entry.path_length, file) != entry.path_length)
+                break;
+            path[entry.path_length] = '\0';
+            SlideshowImage *image = find_image(path, true);
+            image->mtime = entry.mtime;
+            image->width = entry.width;
+            image->height = entry.height;
+            image->decode_time = entry.decode_time;
+            image->orientation = entry.orientation >= 1 && entry.orientation <= 8 ? entry.orientation : 1;
+            image->flags = entry.flags;
+        }
+        log_debug("Read metadata of %u slideshow images from %s", scanner.num_records, scanner.index_path);
+        SDL_UnlockMutex(scanner.mutex);
+    }
+    fclose(file);
+}
+
+// A function to write the metadata of the images in the slideshow to the
+// index, images that are gone are dropped
+static void write_slideshow_index()
+{
+    if (scanner.index_path[0] == '\0')
+        return;
+
+    // Write to a temporary file first so a crash never leaves a partial index behind
+    char tmp_path[MAX_PATH_CHARS + 1];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", scanner.index_path);
+    FILE *file = fopen(tmp_path, "wb");
+    if (file == NULL)
+        return;
+    SDL_LockMutex(scanner.mutex);
+    SlideshowIndexHeader header = {
+        .magic = SLIDESHOW_INDEX_MAGIC,
+        .version = SLIDESHOW_INDEX_VERSION,
+        .num_entries = 0,
+        .reserved = 0
+    };
+    for (SlideshowImage *image = scanner.first_record; image != NULL; image = image->next) {
+        if (image->listed && image->flags)
+            header.num_entries++;
+    }
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (SlideshowImage *image = scanner.first_record; image != NULL && success; image = image->next) {
+        if (!image->listed || !image->flags)
+            continue;
+        SlideshowIndexEntry entry = {
+            .mtime = image->mtime,
+            .width = image->width,
+            .height = image->height,
+            .decode_time = image->decode_time,
+            .path_length = (Uint16) strlen(image->path),
+            .orientation = image->orientation,
+            .flags = image->flags
+        };
+        success = fwrite(&entry, sizeof(entry), 1, file) == 1 &&
+                  fwrite(image->path, 1, entry.path_length, file) == entry.path_length;
+    }
+    scanner.dirty = !success;
+    SDL_UnlockMutex(scanner.mutex);
+    success = !fclose(file) && success;
+    if (!success || rename(tmp_path, scanner.index_path)) {
+        log_error("Could not write slideshow index %s", scanner.index_path);
+        remove(tmp_path);
+        SDL_LockMutex(scanner.mutex);
+        scanner.dirty = true;
+        SDL_UnlockMutex(scanner.mutex);
+    }
+}
+
+// A function to read a 16-bit integer in either byte order
+static Uint32 read_uint16(const Uint8 *p, bool little_endian)
+{
+    return little_endian ? (Uint32) p[0] | (Uint32) p[1] << 8 : (Uint32) p[0] << 8 | (Uint32) p[1];
+}
+
+// A function to read a 32-bit integer in either byte order
+static Uint32 read_uint32(const Uint8 *p, bool little_endian)
+{
+    return little_endian ? read_uint16(p, true) | read_uint16(p + 2, true) << 16 :
+                           read_uint16(p, false) << 16 | read_uint16(p + 2, false);
+}
+
+// A function to find the orientation tag in the first directory of Exif
+// data, returns 1 for upright if there is none
+static Uint8 read_exif_orientation(const Uint8 *tiff, size_t size)
+{
+    if (size < 8)
+        return 1;
+    bool little_endian = tiff[0] == 'I' && tiff[1] == 'I';
+    if (!little_endian && !(tiff[0] == 'M' && tiff[1] == 'M'))
+        return 1;
+    Uint32 offset = read_uint32(tiff + 4, little_endian);
+    if (offset > size - 2)
+        return 1;
+    Uint32 count = read_uint16(tiff + offset, little_endian);
+    for (Uint32 i = 0; i < count && offset + 2 + 12*(i + 1) <= size; i++) {
+        const Uint8 *field = tiff + offset + 2 + 12*i;
+        if (read_uint16(field, little_endian) == 0x0112) {
+            Uint32 orientation = read_uint16(field + 8, little_endian);
+            return orientation >= 1 && orientation <= 8 ? (Uint8) orientation : 1;
+        }
+    }
+    return 1;
+}
+
+// A function to read the dimensions and orientation of a JPEG file by
+// walking its segments up to the frame header
+static bool probe_jpeg(FILE *file, Uint32 *width, Uint32 *height, Uint8 *orientation)
+{
+    Uint8 segment[MAX_PROBE_SEGMENT];
+    Uint8 bytes[2];
+    if (fseek(file, 2, SEEK_SET))
+        return false;
+    while (1) {
+        // Markers may be padded with any number of fill bytes
+        int marker = fgetc(file);
+        if (marker != 0xFF)
+            return false;
+        while ((marker = fgetc(file)) == 0xFF);
+
+        // Give up at the end of the image or the start of the scan
+        if (marker == EOF || marker == 0xD9 || marker == 0xDA)
+            return false;
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            continue;
+        if (fread(bytes, 1, 2, file) != 2)
+            return false;
+        size_t length = read_uint16(bytes, false);
+        if (length < 2)
+            return false;
+        length -= 2;
+        size_t size = MIN(length, sizeof(segment));
+        if (fread(segment, 1, size, file) != size)
+            return false;
+
+        // Start of frame markers, except DHT, JPG and DAC which share the range
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (size < 5)
+                return false;
+            *height = read_uint16(segment + 1, false);
+            *width = read_uint16(segment + 3, false);
+            return true;
+        }
+        if (marker == 0xE1 && size > 6 && !memcmp(segment, "Exif\0\0", 6))
+            *orientation = read_exif_orientation(segment + 6, size - 6);
+        if (length > size && fseek(file, (long) (length - size), SEEK_CUR))
+            return false;
+    }
+}
+
+// A function to read the dimensions and orientation of a JPEG, PNG or
+// WebP image from its header without decoding it
+static bool probe_image(const char *path, Uint32 *width, Uint32 *height, Uint8 *orientation)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    Uint8 header[32];
+    size_t size = fread(header, 1, sizeof(header), file);
+    bool success = false;
+    *orientation = 1;
+    if (size >= 2 && header[0] == 0xFF && header[1] == 0xD8)
+        success = probe_jpeg(file, width, height, orientation);
+    else if (size >= 24 && !memcmp(header, "\x89PNG\r\n\x1A\n", 8) && !memcmp(header + 12, "IHDR", 4)) {
+        *width = read_uint32(header + 16, false);
+        *height = read_uint32(header + 20, false);
+        success = true;
+    }
+    else if (size >= 30 && !memcmp(header, "RIFF", 4) && !memcmp(header + 8, "WEBP", 4)) {
+        // Lossy, lossless and extended bitstreams store the size differently
+        const Uint8 *chunk = header + 20;
+        if (!memcmp(header + 12, "VP8 ", 4) && !memcmp(chunk + 3, "\x9D\x01\x2A", 3)) {
+            *width = read_uint16(chunk + 6, true) & 0x3FFF;
+            *height = read_uint16(chunk + 8, true) & 0x3FFF;
+            success = true;
+        }
+        else if (!memcmp(header + 12, "VP8L", 4) && chunk[0] == 0x2F) {
+            Uint32 bits = read_uint32(chunk + 1, true);
+            *width = (bits & 0x3FFF) + 1;
+            *height = (bits >> 14 & 0x3FFF) + 1;
+            success = true;
+        }
+        else if (!memcmp(header + 12, "VP8X", 4)) {
+            *width = (read_uint32(chunk + 4, true) & 0xFFFFFF) + 1;
+            *height = (read_uint32(chunk + 6, true) >> 8) + 1;
+            success = true;
+        }
+    }
+    fclose(file);
+    return success;
+}
+
+// A function to verify an image against its file, reading the header
+// again if the file changed since it was last seen. Safe to call from any thread
+void probe_slideshow_image(SlideshowImage *image)
+{
+    Sint64 mtime = get_modification_time(image->path);
+    SDL_LockMutex(scanner.mutex);
+    if (image->checked) {
+        SDL_UnlockMutex(scanner.mutex);
+        return;
+    }
+    bool probed = mtime == image->mtime && (image->flags & IMAGE_PROBED);
+    SDL_UnlockMutex(scanner.mutex);
+
+    // Read the header without holding the lock
+    Uint32 width = 0;
+    Uint32 height = 0;
+    Uint8 orientation = 1;
+    if (!probed)
+        probe_image(image->path, &width, &height, &orientation);
+    SDL_LockMutex(scanner.mutex);
+    if (!probed) {
+        image->mtime = mtime;
+        image->width = width;
+        image->height = height;
+        image->orientation = orientation;
+        image->decode_time = 0;
+        image->flags = IMAGE_PROBED;
+        scanner.dirty = true;
+    }
+    if (!image->checked) {
+        image->checked = true;
+        if (image->listed)
+            scanner.num_unchecked--;
+    }
+    SDL_UnlockMutex(scanner.mutex);
+}
+
+// A function to verify every image not yet verified this run, then save
+// the index if anything changed. Runs on the scanner thread
+void verify_slideshow_images()
+{
+    SDL_LockMutex(scanner.mutex);
+    SlideshowImage *image = scanner.num_unchecked ? scanner.first_record : NULL;
+    SDL_UnlockMutex(scanner.mutex);
+    while (image != NULL) {
+        SDL_LockMutex(scanner.mutex);
+        bool quit = scanner.quit;
+        bool pending = image->listed && !image->checked;
+        SlideshowImage *next = image->next;
+        SDL_UnlockMutex(scanner.mutex);
+        if (quit)
+            return;
+        if (pending)
+            probe_slideshow_image(image);
+        image = next;
+    }
+    SDL_LockMutex(scanner.mutex);
+    bool save = scanner.scanned && scanner.dirty;
+    SDL_UnlockMutex(scanner.mutex);
+    if (save)
+        write_slideshow_index();
+}
+
+// A function to record the outcome of decoding an image, images that fail
+// are skipped until their file changes
+void record_slideshow_decode(SlideshowImage *image, SDL_Surface *surface, Uint32 decode_time)
+{
+    SDL_LockMutex(scanner.mutex);
+    if (surface == NULL)
+        image->flags = (Uint8) ((image->flags & ~IMAGE_DECODED) | IMAGE_FAILED);
+    else {
+        image->flags = (Uint8) ((image->flags & ~IMAGE_FAILED) | IMAGE_DECODED);
+        image->decode_time = decode_time ? decode_time : 1;
+        if (!image->width || !image->height) {
+            image->width = (Uint32) surface->w;
+            image->height = (Uint32) surface->h;
+        }
+        scanner.decode_time += decode_time;
+        scanner.num_decoded++;
+    }
+    scanner.dirty = true;
+    SDL_UnlockMutex(scanner.mutex);
+}
+
+// A function to wait until the first image is found or the scan is
+// complete, returns the number of images found so far
+int wait_for_slideshow_images(bool *scanned)
+{
+    SDL_LockMutex(scanner.mutex);
+    while (!scanner.num_images && !scanner.scanned && !scanner.quit)
+        SDL_CondWait(scanner.cond, scanner.mutex);
+    int num_images = scanner.num_images;
+    *scanned = scanner.scanned;
+    SDL_UnlockMutex(scanner.mutex);
+    return num_images;
+}
+
+// A function to determine if the scan of the directory tree is complete
+bool slideshow_scanned()
+{
+    SDL_LockMutex(scanner.mutex);
+    bool scanned = scanner.scanned;
+    SDL_UnlockMutex(scanner.mutex);
+    return scanned;
+}
+
+// A function to determine if an image is likely cheaper to decode than
+// another, by measured decode time if both were decoded, else by pixels
+static bool is_cheaper(const SlideshowImage *a, const SlideshowImage *b)
+{
+    if (a->decode_time && b->decode_time)
+        return a->decode_time < b->decode_time;
+    return (Uint64) a->width * a->height < (Uint64) b->width * b->height;
+}
+
+// A function to get a random index below size, rand() may only give 15 bits
+static int random_index(int size)
+{
+    Uint32 random = ((Uint32) rand() << 16) ^ (Uint32) rand();
+    return (int) (random % (Uint32) size);
+}
+
+// A function to draw the next image with an incremental Fisher-Yates shuffle,
+// see https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle. Every image
+// is shown once per cycle, images known to fail are passed over and the
+// current image is skipped unless it is the only one left. Returns NULL if
+// there is no image to show
+SlideshowImage *next_slideshow_image(SlideshowImage *current, int *num_images)
+{
+    SDL_LockMutex(scanner.mutex);
+    SlideshowImage *image = NULL;
+
+    // Decoding is slow on this machine, prefer the cheaper of two images
+    bool slow = scanner.num_decoded && scanner.decode_time / scanner.num_decoded > SLOW_DECODE_TIME;
+
+    // The rest of one cycle and all of the next draw every image at least once
+    for (int draws = 0; scanner.num_images && draws <= 2*scanner.num_images; draws++) {
+        if (scanner.num_shown >= scanner.num_images)
+            scanner.num_shown = 0;
+        int remaining = scanner.num_images - scanner.num_shown;
+        int i = scanner.num_shown + random_index(remaining);
+        if (slow && remaining > 1) {
+            int j = scanner.num_shown + random_index(remaining);
+            if (is_cheaper(scanner.images[j], scanner.images[i]))
+                i = j;
+        }
+        SlideshowImage *candidate = scanner.images[i];
+        place_image(scanner.images[scanner.num_shown], i);
+        place_image(candidate, scanner.num_shown++);
+        if (candidate->flags & IMAGE_FAILED)
+            continue;
+        image = candidate;
+        if (image != current || scanner.num_images == 1)
+            break;
+    }
+    *num_images = scanner.num_images;
+    SDL_UnlockMutex(scanner.mutex);
+    return image;
+}
@@ -0,0 +1,70 @@
+#define SCANNER_THREAD_NAME "Scanner Thread"
+#define SCANNER_MIN_IMAGES 256
+#define IMAGE_TABLE_MIN_SIZE 512
+#define SLOW_DECODE_TIME 250 // Average decode time in ms above which cheaper images are preferred
+#define MAX_PROBE_SEGMENT 4096 // Bytes of a JPEG Exif segment read for the orientation
+
+// Slideshow image flags
+#define IMAGE_PROBED 0x01 // Dimensions and orientation were read from the header
+#define IMAGE_DECODED 0x02
+#define IMAGE_FAILED 0x04 // Decoding failed, skipped until the file changes
+
+// Slideshow metadata index
+#define SLIDESHOW_INDEX_FILENAME "slideshow.idx"
+#define SLIDESHOW_INDEX_MAGIC 0x58444953 // "SIDX"
+#define SLIDESHOW_INDEX_VERSION 1
+
+// Header of the slideshow metadata index, followed by the entries
+typedef struct {
+    Uint32 magic;
+    Uint32 version;
+    Uint32 num_entries;
+    Uint32 reserved;
+} SlideshowIndexHeader;
+
+// Entry of the slideshow metadata index, followed by path_length bytes of path
+typedef struct {
+    Sint64 mtime;
+    Uint32 width;
+    Uint32 height;
+    Uint32 decode_time;
+    Uint16 path_length;
+    Uint8  orientation;
+    Uint8  flags;
+} SlideshowIndexEntry;
+
+// Images of the slideshow directory tree, found by a background thread
+typedef struct {
+    SDL_Thread     *thread;
+    SDL_mutex      *mutex; // Guards everything below and the image records
+    SDL_cond       *cond;
+    Arena          arena; // Holds the image records, kept until the scanner quits
+    SlideshowImage **table; // Open addressing hash table of the records by path
+    Uint32         table_capacity;
+    Uint32         num_records;
+    SlideshowImage *first_record; // Every record in the order found
+    SlideshowImage *last_record;
+    SlideshowImage **images; // Listed records shuffled in place, the first num_shown were shown this cycle
+    int            num_images;
+    int            num_shown;
+    int            capacity;
+    int            num_unchecked; // Listed images not verified against their files yet
+    Uint32         decode_time; // Total time and count of decodes this run
+    Uint32         num_decoded;
+    bool           scanned; // The directory tree has been read once
+    bool           dirty; // The records changed since the index was written
+    bool           quit;
+    char           index_path[MAX_PATH_CHARS + 1];
+} ImageScanner;
+
+int init_scanner(const char *directory);
+void quit_scanner(void);
+bool add_slideshow_image(const char *path);
+void remove_slideshow_image(const char *path);
+void remove_slideshow_directory(const char *directory);
+void verify_slideshow_images(void);
+void probe_slideshow_image(SlideshowImage *image);
+void record_slideshow_decode(SlideshowImage *image, SDL_Surface *surface, Uint32 decode_time);
+int wait_for_slideshow_images(bool *scanned);
+bool slideshow_scanned(void);
+SlideshowImage *next_slideshow_image(SlideshowImage *current, int *num_images);
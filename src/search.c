@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <SDL.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "search.h"
+#include "debug.h"
+
+static void normalize_text(char *dest, const char *src, size_t size);
+static bool is_word_start(const char *key, size_t i);
+static Uint32 get_trigram(const char *text);
+static Uint32 hash_trigram(Uint32 trigram);
+static TrigramList *find_trigram(SearchIndex *index, Uint32 trigram);
+static TrigramList *add_trigram(SearchIndex *index, Uint32 trigram);
+static void grow_trigram_table(SearchIndex *index);
+static int compare_words(const void *a, const void *b);
+static void match_word_prefix(SearchIndex *index);
+static void match_trigrams(SearchIndex *index);
+static void filter_matches(SearchIndex *index);
+static int get_match_rank(SearchItem *item, const char *query);
+
+// Index being sorted, qsort() has no user data parameter
+static SearchIndex *sort_index = NULL;
+
+// A function to copy text in lowercase, the bytes of multibyte UTF-8
+// characters are copied unchanged
+static void normalize_text(char *dest, const char *src, size_t size)
+{
+    size_t i;
+    for (i = 0; i + 1 < size && src[i] != '\0'; i++)
+        dest[i] = (char) ((Uint8) src[i] < 0x80 ? tolower((Uint8) src[i]) : src[i]);
+    dest[i] = '\0';
+}
+
+// A function to check whether a word starts at a position in a key, words
+// are separated by ASCII punctuation and spaces
+static bool is_word_start(const char *key, size_t i)
+{
+    Uint8 c = (Uint8) key[i];
+    if (c < 0x80 && !isalnum(c))
+        return false;
+    if (i == 0)
+        return true;
+    Uint8 previous = (Uint8) key[i - 1];
+    return previous < 0x80 && !isalnum(previous);
+}
+
+// A function to pack the first three bytes of text into a trigram
+static Uint32 get_trigram(const char *text)
+{
+    return (Uint32) (Uint8) text[0] << 16 | (Uint32) (Uint8) text[1] << 8 | (Uint8) text[2];
+}
+
+// A function to scatter trigrams over the hash table
+static Uint32 hash_trigram(Uint32 trigram)
+{
+    return trigram * 2654435761u;
+}
+
+// A function to find the posting list of a trigram, returns NULL if no title contains it
+static TrigramList *find_trigram(SearchIndex *index, Uint32 trigram)
+{
+    if (!index->capacity)
+        return NULL;
+    Uint32 i = hash_trigram(trigram) & (index->capacity - 1);
+    while (index->trigrams[i].trigram != SEARCH_EMPTY_TRIGRAM) {
+        if (index->trigrams[i].trigram == trigram)
+            return index->trigrams + i;
+        i = (i + 1) & (index->capacity - 1);
+    }
+    return NULL;
+}
+
+// A function to double the size of the trigram table
+static void grow_trigram_table(SearchIndex *index)
+{
+    Uint32 capacity = index->capacity ? 2 * index->capacity : SEARCH_TABLE_MIN_SIZE;
+    TrigramList *trigrams = malloc(capacity * sizeof(TrigramList));
+    if (trigrams == NULL)
+        log_fatal("Could not allocate search index");
+    for (Uint32 i = 0; i < capacity; i++)
+        trigrams[i].trigram = SEARCH_EMPTY_TRIGRAM;
+    for (Uint32 i = 0; i < index->capacity; i++) {
+        if (index->trigrams[i].trigram == SEARCH_EMPTY_TRIGRAM)
+            continue;
+        Uint32 j = hash_trigram(index->trigrams[i].trigram) & (capacity - 1);
+        while (trigrams[j].trigram != SEARCH_EMPTY_TRIGRAM)
+            j = (j + 1) & (capacity - 1);
+        trigrams[j] = index->trigrams[i];
+    }
+    free(index->trigrams);
+    index->trigrams = trigrams;
+    index->capacity = capacity;
+}
+
+// A function to find or insert the posting list of a trigram
+static TrigramList *add_trigram(SearchIndex *index, Uint32 trigram)
+{
+    TrigramList *list = find_trigram(index, trigram);
+    if (list != NULL)
+        return list;
+
+    // Keep the table at most half full
+    if (2 * (index->num_trigrams + 1) > index->capacity)
+        grow_trigram_table(index);
+    Uint32 i = hash_trigram(trigram) & (index->capacity - 1);
+    while (index->trigrams[i].trigram != SEARCH_EMPTY_TRIGRAM)
+        i = (i + 1) & (index->capacity - 1);
+    index->trigrams[i] = (TrigramList) {
+        .trigram = trigram,
+        .count = 0,
+        .offset = 0,
+        .last_item = SEARCH_EMPTY_TRIGRAM
+    };
+    index->num_trigrams++;
+    return index->trigrams + i;
+}
+
+// A function to order words by the key text that follows them
+static int compare_words(const void *a, const void *b)
+{
+    const SearchWord *word_a = (const SearchWord*) a;
+    const SearchWord *word_b = (const SearchWord*) b;
+    return strcmp(sort_index->items[word_a->item].key + word_a->offset,
+               sort_index->items[word_b->item].key + word_b->offset);
+}
+
+// A function to build the search index over the entries of all menus
+void build_search_index(SearchIndex *index, Menu *first_menu)
+{
+    *index = (SearchIndex) {0};
+    for (Menu *menu = first_menu; menu != NULL; menu = menu->next)
+        index->num_items += menu->num_entries;
+    if (!index->num_items)
+        return;
+    index->items = malloc(index->num_items * sizeof(SearchItem));
+    index->matches = malloc(index->num_items * sizeof(Uint32));
+    index->marks = calloc(index->num_items, sizeof(Uint32));
+    if (index->items == NULL || index->matches == NULL || index->marks == NULL)
+        log_fatal("Could not allocate search index");
+
+    // Normalize the titles and count the words and trigrams
+    Uint32 num_items = 0;
+    size_t total_words = 0;
+    for (Menu *menu = first_menu; menu != NULL; menu = menu->next) {
+        for (Entry *entry = menu->first_entry; entry != NULL; entry = entry->next) {
+            const char *title = entry->title != NULL ? entry->title : "";
+            size_t length = strlen(title);
+            char *key = malloc(length + 1);
+            if (key == NULL)
+                log_fatal("Could not allocate search index");
+            normalize_text(key, title, length + 1);
+            index->items[num_items] = (SearchItem) {
+                .entry = entry,
+                .menu = menu,
+                .key = key
+            };
+            for (size_t i = 0; i < length; i++) {
+                if (is_word_start(key, i))
+                    total_words++;
+            }
+            for (size_t i = 0; i + SEARCH_TRIGRAM_LENGTH <= length; i++) {
+                TrigramList *list = add_trigram(index, get_trigram(key + i));
+                if (list->last_item != num_items) {
+                    list->last_item = num_items;
+                    list->count++;
+                }
+            }
+            num_items++;
+        }
+    }
+    index->num_items = num_items;
+
+    // Lay the posting lists out back to back, then fill them in item order
+    Uint32 total_postings = 0;
+    for (Uint32 i = 0; i < index->capacity; i++) {
+        TrigramList *list = index->trigrams + i;
+        if (list->trigram == SEARCH_EMPTY_TRIGRAM)
+            continue;
+        list->offset = total_postings;
+        total_postings += list->count;
+        list->count = 0;
+        list->last_item = SEARCH_EMPTY_TRIGRAM;
+    }
+    index->postings = malloc((total_postings ? total_postings : 1) * sizeof(Uint32));
+    index->words = malloc((total_words ? total_words : 1) * sizeof(SearchWord));
+    if (index->postings == NULL || index->words == NULL)
+        log_fatal("Could not allocate search index");
+    for (Uint32 item = 0; item < num_items; item++) {
+        const char *key = index->items[item].key;
+        size_t length = strlen(key);
+        for (size_t i = 0; i < length; i++) {
+            if (is_word_start(key, i)) {
+                index->words[index->num_words] = (SearchWord) {
+                    .item = item,
+                    .offset = (Uint32) i
+                };
+                index->num_words++;
+            }
+        }
+        for (size_t i = 0; i + SEARCH_TRIGRAM_LENGTH <= length; i++) {
+            TrigramList *list = find_trigram(index, get_trigram(key + i));
+            if (list->last_item != item) {
+                list->last_item = item;
+                index->postings[list->offset + list->count] = item;
+                list->count++;
+            }
+        }
+    }
+    sort_index = index;
+    qsort(index->words, index->num_words, sizeof(SearchWord), compare_words);
+    sort_index = NULL;
+    log_debug("Indexed %u entries for search, %u words, %u trigrams",
+        index->num_items,
+        index->num_words,
+        index->num_trigrams
+    );
+}
+
+// A function to match items with a word starting with a query shorter than
+// a trigram, by binary searching the sorted words for the range sharing the prefix
+static void match_word_prefix(SearchIndex *index)
+{
+    const char *query = index->query;
+    size_t length = index->query_length;
+    Uint32 low = 0;
+    Uint32 high = index->num_words;
+    while (low < high) {
+        Uint32 middle = low + (high - low) / 2;
+        SearchWord *word = index->words + middle;
+        if (strncmp(index->items[word->item].key + word->offset, query, length) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // Mark each item in the range, then collect them in index order
+    index->generation++;
+    for (Uint32 i = low; i < index->num_words; i++) {
+        SearchWord *word = index->words + i;
+        if (strncmp(index->items[word->item].key + word->offset, query, length))
+            break;
+        index->marks[word->item] = index->generation;
+    }
+    index->num_matches = 0;
+    for (Uint32 item = 0; item < index->num_items; item++) {
+        if (index->marks[item] == index->generation)
+            index->matches[index->num_matches++] = item;
+    }
+}
+
+// A function to match items containing the query from scratch. Every
+// match contains all of the query's trigrams, so only the items in the
+// shortest posting list need to be checked
+static void match_trigrams(SearchIndex *index)
+{
+    TrigramList *shortest = NULL;
+    index->num_matches = 0;
+    for (size_t i = 0; i + SEARCH_TRIGRAM_LENGTH <= index->query_length; i++) {
+        TrigramList *list = find_trigram(index, get_trigram(index->query + i));
+        if (list == NULL)
+            return;
+        if (shortest == NULL || list->count < shortest->count)
+            shortest = list;
+    }
+    for (Uint32 i = 0; i < shortest->count; i++) {
+        Uint32 item = index->postings[shortest->offset + i];
+        if (strstr(index->items[item].key, index->query) != NULL)
+            index->matches[index->num_matches++] = item;
+    }
+}
+
+// A function to narrow the previous matches to those containing the longer query
+static void filter_matches(SearchIndex *index)
+{
+    Uint32 num_matches = 0;
+    for (Uint32 i = 0; i < index->num_matches; i++) {
+        Uint32 item = index->matches[i];
+        if (strstr(index->items[item].key, index->query) != NULL)
+            index->matches[num_matches++] = item;
+    }
+    index->num_matches = num_matches;
+}
+
+// A function to update the matches for a new query. Typing a character
+// only rechecks the current matches, other changes start from the index
+void set_search_query(SearchIndex *index, const char *query)
+{
+    char normalized[SEARCH_MAX_QUERY + 1];
+    normalize_text(normalized, query, sizeof(normalized));
+    size_t length = strlen(normalized);
+    bool extends = index->query_length >= SEARCH_TRIGRAM_LENGTH &&
+                   length > index->query_length &&
+                   !strncmp(normalized, index->query, index->query_length);
+    memcpy(index->query, normalized, length + 1);
+    index->query_length = length;
+    if (!index->num_items || !length)
+        index->num_matches = 0;
+    else if (extends)
+        filter_matches(index);
+    else if (length < SEARCH_TRIGRAM_LENGTH)
+        match_word_prefix(index);
+    else
+        match_trigrams(index);
+}
+
+// A function to rank a match, titles starting with the query come first,
+// then titles with a word starting with it
+static int get_match_rank(SearchItem *item, const char *query)
+{
+    int rank = SEARCH_RANKS - 1;
+    for (const char *match = strstr(item->key, query); match != NULL; match = strstr(match + 1, query)) {
+        if (match == item->key)
+            return 0;
+        if (is_word_start(item->key, (size_t) (match - item->key)))
+            rank = 1;
+    }
+    return rank;
+}
+
+// A function to get the best matches of the current query, in rank order
+// and then in menu order
+int get_search_results(SearchIndex *index, SearchItem **results, int max_results)
+{
+    // The first rank goes straight into the results, the others wait
+    // in case enough better matches follow
+    SearchItem *ranked[SEARCH_RANKS - 1][SEARCH_MAX_RESULTS];
+    int num_ranked[SEARCH_RANKS - 1] = {0};
+    int num_results = 0;
+    if (max_results > SEARCH_MAX_RESULTS)
+        max_results = SEARCH_MAX_RESULTS;
+    for (Uint32 i = 0; i < index->num_matches && num_results < max_results; i++) {
+        SearchItem *item = index->items + index->matches[i];
+        int rank = get_match_rank(item, index->query);
+        if (!rank)
+            results[num_results++] = item;
+        else if (num_ranked[rank - 1] < max_results)
+            ranked[rank - 1][num_ranked[rank - 1]++] = item;
+    }
+    for (int rank = 0; rank < SEARCH_RANKS - 1; rank++) {
+        for (int i = 0; i < num_ranked[rank] && num_results < max_results; i++)
+            results[num_results++] = ranked[rank][i];
+    }
+    return num_results;
+}
+
+// A function to free the search index
+void free_search_index(SearchIndex *index)
+{
+    for (Uint32 i = 0; i < index->num_items; i++)
+        free(index->items[i].key);
+    free(index->items);
+    free(index->words);
+    free(index->trigrams);
+    free(index->postings);
+    free(index->matches);
+    free(index->marks);
+    *index = (SearchIndex) {0};
+}
@@ -0,0 +1,73 @@
+#define SEARCH_MAX_QUERY 64
+#define SEARCH_MAX_RESULTS 32
+#define SEARCH_SLOTS (2*SEARCH_MAX_RESULTS)
+#define SEARCH_TRIGRAM_LENGTH 3
+#define SEARCH_RANKS 3
+#define SEARCH_TABLE_MIN_SIZE 1024
+#define SEARCH_EMPTY_TRIGRAM 0xFFFFFFFF
+#define SEARCH_PROMPT "Search: "
+#define SEARCH_MENU_NAME "Search"
+
+// Entry indexed for search
+typedef struct {
+    Entry *entry;
+    Menu  *menu;
+    char  *key; // Lowercase title
+} SearchItem;
+
+// Start of a word in an item key, for prefix matching
+typedef struct {
+    Uint32 item;
+    Uint32 offset;
+} SearchWord;
+
+// Posting list of the items containing a trigram
+typedef struct {
+    Uint32 trigram; // SEARCH_EMPTY_TRIGRAM when the slot is free
+    Uint32 count;
+    Uint32 offset; // Start of the list in the postings array
+    Uint32 last_item; // Last item counted, so each item is listed once
+} TrigramList;
+
+// Prefix and trigram index over the titles of all entries, and the
+// matches of the current query, which narrow as it grows
+typedef struct {
+    SearchItem  *items;
+    Uint32      num_items;
+    SearchWord  *words; // Sorted by the key text from the start of the word
+    Uint32      num_words;
+    TrigramList *trigrams; // Open addressing hash table keyed by trigram
+    Uint32      capacity;
+    Uint32      num_trigrams;
+    Uint32      *postings;
+    char        query[SEARCH_MAX_QUERY + 1];
+    size_t      query_length;
+    Uint32      *matches; // Item indices in index order
+    Uint32      num_matches;
+    Uint32      *marks; // Generation each item was last matched in, for deduplication
+    Uint32      generation;
+} SearchIndex;
+
+// Entry in the search results menu. A slot keeps its textures while its
+// entry stays in the results, and isn't reused while icons are pending
+typedef struct {
+    Entry        entry; // Must be first, results are accessed through the entry
+    Entry        *source;
+    unsigned int pending_icons;
+    bool         used;
+} SearchSlot;
+
+// Search mode state, the results are shown as a virtual menu
+typedef struct {
+    Menu       menu;
+    Menu       *origin; // Menu shown before the search started
+    SearchSlot slots[SEARCH_SLOTS];
+    char       query[SEARCH_MAX_QUERY + 1];
+    TextLayout prompt_layout;
+    SDL_Rect   prompt_rect;
+} Search;
+
+void build_search_index(SearchIndex *index, Menu *first_menu);
+void set_search_query(SearchIndex *index, const char *query);
+int get_search_results(SearchIndex *index, SearchItem **results, int max_results);
+void free_search_index(SearchIndex *index);
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "image.h"
+#include "text.h"
+#include "trace.h"
+#include "util.h"
+#include "debug.h"
+
+static GlyphCache *get_glyph_cache(TTF_Font *font, bool owns_font, const char *font_path, int font_size);
+static Glyph *get_glyph(GlyphCache *cache, Uint16 code_point);
+static Glyph *insert_glyph(GlyphCache *cache, Uint16 code_point);
+static void grow_glyph_table(GlyphCache *cache);
+static bool pack_glyph(int w, int h, int *page, SDL_Rect *rect);
+static bool add_atlas_page(void);
+static void add_glyph_quad(TextLayout *layout, Glyph *glyph, int x);
+static void draw_glyph_quads(TextLayout *layout, SDL_Color *color, int x, int y);
+
+extern SDL_Renderer *renderer;
+static GlyphCache *glyph_caches = NULL;
+static AtlasPage *atlas_pages   = NULL;
+static int num_atlas_pages      = 0;
+
+// A function to hash a code point into the glyph table
+static inline Uint32 hash_code_point(Uint16 code_point, Uint32 capacity)
+{
+    return ((Uint32) code_point * 2654435761u) & (capacity - 1);
+}
+
+// A function to find the glyph cache for a font and size, creating it if necessary
+static GlyphCache *get_glyph_cache(TTF_Font *font, bool owns_font, const char *font_path, int font_size)
+{
+    GlyphCache *cache;
+    for (cache = glyph_caches; cache != NULL; cache = cache->next) {
+        if (cache->font_size == font_size && MATCH(cache->font_path, font_path))
+            return cache;
+    }
+
+    cache = malloc(sizeof(GlyphCache));
+    *cache = (GlyphCache) {
+        .font_path = strdup(font_path),
+        .font_size = font_size,
+        .font = font,
+        .owns_font = owns_font,
+        .height = TTF_FontHeight(font),
+        .glyphs = calloc(GLYPH_TABLE_MIN_SIZE, sizeof(Glyph)),
+        .capacity = GLYPH_TABLE_MIN_SIZE,
+        .num_glyphs = 0,
+        .next = glyph_caches
+    };
+    glyph_caches = cache;
+    return cache;
+}
+
+// A function to double the size of the glyph hash table
+static void grow_glyph_table(GlyphCache *cache)
+{
+    Glyph *old_glyphs = cache->glyphs;
+    Uint32 old_capacity = cache->capacity;
+    cache->capacity *= 2;
+    cache->glyphs = calloc(cache->capacity, sizeof(Glyph));
+    for (Uint32 i = 0; i < old_capacity; i++) {
+        if (old_glyphs[i].code_point) {
+            Uint32 j = hash_code_point(old_glyphs[i].code_point, cache->capacity);
+            while (cache->glyphs[j].code_point)
+                j = (j + 1) & (cache->capacity - 1);
+            cache->glyphs[j] = old_glyphs[i];
+        }
+    }
+    free(old_glyphs);
+}
+
+// A function to add a page to the glyph atlas
+static bool add_atlas_page()
+{
+    SDL_Texture *texture = SDL_CreateTexture(renderer,
+                               SDL_PIXELFORMAT_ARGB8888,
+                               SDL_TEXTUREACCESS_STATIC,
+                               GLYPH_ATLAS_SIZE,
+                               GLYPH_ATLAS_SIZE
+                           );
+    if (texture == NULL) {
+        log_error("Could not create glyph atlas texture\n%s", SDL_GetError());
+        return false;
+    }
+
+    // Clear the page so padding between glyphs is transparent
+    Uint32 *pixels = calloc(GLYPH_ATLAS_SIZE * GLYPH_ATLAS_SIZE, sizeof(Uint32));
+    SDL_UpdateTexture(texture, NULL, pixels, GLYPH_ATLAS_SIZE * (int) sizeof(Uint32));
+    free(pixels);
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    atlas_pages = realloc(atlas_pages, (size_t) (num_atlas_pages + 1) * sizeof(AtlasPage));
+    atlas_pages[num_atlas_pages] = (AtlasPage) {
+        .texture = texture,
+        .num_shelves = 0,
+        .next_y = 0
+    };
+    num_atlas_pages++;
+    return true;
+}
+
+// A function to find space for a glyph bitmap in the atlas
+static bool pack_glyph(int w, int h, int *page, SDL_Rect *rect)
+{
+    int padded_w = w + GLYPH_ATLAS_PADDING;
+    int padded_h = h + GLYPH_ATLAS_PADDING;
+    if (padded_w > GLYPH_ATLAS_SIZE || padded_h > GLYPH_ATLAS_SIZE)
+        return false;
+
+    for (int i = 0; ; i++) {
+        if (i == num_atlas_pages && !add_atlas_page())
+            return false;
+        AtlasPage *p = atlas_pages + i;
+
+        // Use an existing shelf of similar height if there is room
+        Shelf *shelf = NULL;
+        for (int j = 0; j < p->num_shelves; j++) {
+            Shelf *s = p->shelves + j;
+            if (s->height >= padded_h && s->height <= padded_h + padded_h / 4 &&
+            s->x + padded_w <= GLYPH_ATLAS_SIZE) {
+                shelf = s;
+                break;
+            }
+        }
+
+        // Otherwise start a new shelf below the last one
+        if (shelf == NULL && p->num_shelves < GLYPH_ATLAS_MAX_SHELVES &&
+        p->next_y + padded_h <= GLYPH_ATLAS_SIZE) {
+            shelf = p->shelves + p->num_shelves;
+            *shelf = (Shelf) {
+                .y = p->next_y,
+                .height = padded_h,
+                .x = 0
+            };
+            p->num_shelves++;
+            p->next_y += padded_h;
+        }
+        if (shelf != NULL) {
+            *page = i;
+            *rect = (SDL_Rect) {shelf->x, shelf->y, w, h};
+            shelf->x += padded_w;
+            return true;
+        }
+    }
+}
+
+// A function to rasterize a glyph and add it to the cache
+static Glyph *insert_glyph(GlyphCache *cache, Uint16 code_point)
+{
+    if (2*(cache->num_glyphs + 1) > cache->capacity)
+        grow_glyph_table(cache);
+    Uint32 i = hash_code_point(code_point, cache->capacity);
+    while (cache->glyphs[i].code_point)
+        i = (i + 1) & (cache->capacity - 1);
+    Glyph *glyph = cache->glyphs + i;
+    *glyph = (Glyph) {
+        .code_point = code_point,
+        .page = 0,
+        .rect = {0, 0, 0, 0},
+        .origin = 0,
+        .advance = 0
+    };
+    cache->num_glyphs++;
+
+    int minx, maxx, miny, maxy;
+    if (TTF_GlyphMetrics(cache->font, code_point, &minx, &maxx, &miny, &maxy, &glyph->advance) == -1)
+        return glyph;
+    glyph->origin = minx < 0 ? -minx : 0;
+
+    // Rasterize in white so the color can be applied with texture color modulation
+    SDL_Color white = {0xFF, 0xFF, 0xFF, 0xFF};
+    SDL_Surface *surface = TTF_RenderGlyph_Blended(cache->font, code_point, white);
+    if (surface == NULL)
+        return glyph;
+    if (pack_glyph(surface->w, surface->h, &glyph->page, &glyph->rect))
+        SDL_UpdateTexture(atlas_pages[glyph->page].texture, &glyph->rect, surface->pixels, surface->pitch);
+    else
+        log_error("Could not fit glyph U+%04X into the glyph atlas", code_point);
+    SDL_FreeSurface(surface);
+    return glyph;
+}
+
+// A function to get a glyph from the cache, rasterizing it on first use
+static Glyph *get_glyph(GlyphCache *cache, Uint16 code_point)
+{
+    Uint32 i = hash_code_point(code_point, cache->capacity);
+    while (cache->glyphs[i].code_point) {
+        if (cache->glyphs[i].code_point == code_point)
+            return cache->glyphs + i;
+        i = (i + 1) & (cache->capacity - 1);
+    }
+    return insert_glyph(cache, code_point);
+}
+
+// A function to append a glyph quad to a layout
+static void add_glyph_quad(TextLayout *layout, Glyph *glyph, int x)
+{
+    if (layout->num_quads == layout->capacity) {
+        layout->capacity = layout->capacity ? 2*layout->capacity : 16;
+        layout->quads = realloc(layout->quads, (size_t) layout->capacity * sizeof(GlyphQuad));
+    }
+    layout->quads[layout->num_quads] = (GlyphQuad) {
+        .page = glyph->page,
+        .src = glyph->rect,
+        .dst = {x, 0, glyph->rect.w, glyph->rect.h}
+    };
+    layout->num_quads++;
+}
+
+// A function to lay out a string of text as quads from the glyph atlas
+int layout_text(const char *text, TextInfo *info, TextLayout *layout, SDL_Rect *rect, int *text_height)
+{
+    TRACE_BEGIN(layout_text);
+    TTF_Font *output_font = info->font;
+    int font_size = info->font_size;
+    int w, h;
+
+    // Only copy the text if it needs to be truncated, so that relaying
+    // out text whose glyphs are already cached doesn't allocate
+    char *text_buffer = (char*) text;
+
+    // Calculate size of the rendered title
+    TTF_SizeUTF8(info->font, text_buffer, &w, &h);
+
+    // If title is too large to fit
+    if (info->oversize_mode != OVERSIZE_NONE && w > info->max_width) {
+
+        // Truncate mode:
+        if (info->oversize_mode == OVERSIZE_TRUNCATE) {
+            text_buffer = strdup(text);
+            utf8_truncate(text_buffer, w, info->max_width);
+            TTF_SizeUTF8(info->font, text_buffer, &w, &h);
+        }
+
+        // Shrink mode: keep trying smaller font until it fits
+        else if (info->oversize_mode == OVERSIZE_SHRINK) {
+            TTF_Font *reduced_font = NULL;
+            int size = info->font_size;
+            while (w > info->max_width && --size > 0) {
+                if (reduced_font != NULL)
+                    TTF_CloseFont(reduced_font);
+                reduced_font = TTF_OpenFont(*info->font_path, size);
+                if (reduced_font == NULL)
+                    break;
+                TTF_SizeUTF8(reduced_font, text_buffer, &w, &h);
+            }
+            if (reduced_font != NULL && size > 0) {
+                output_font = reduced_font;
+                font_size = size;
+            }
+            else if (reduced_font != NULL)
+                TTF_CloseFont(reduced_font);
+        }
+    }
+
+    // The glyph cache takes ownership of a reduced font, unless one
+    // already exists for that size
+    bool reduced = output_font != info->font;
+    GlyphCache *cache = get_glyph_cache(output_font, reduced, *info->font_path, font_size);
+    if (reduced && cache->font != output_font)
+        TTF_CloseFont(output_font);
+
+    // Place each glyph at the pen position, compensating for negative
+    // left bearing on the first character the same way SDL_ttf does
+    layout->num_quads = 0;
+    int pen = 0;
+    int width = 0;
+    Uint16 previous = 0;
+    int bytes;
+    for (char *p = text_buffer; *p != '\0'; p += bytes) {
+        Uint16 code_point = get_unicode_code_point(p, &bytes);
+        Glyph *glyph = get_glyph(cache, code_point);
+        if (previous)
+            pen += TTF_GetFontKerningSizeGlyphs(cache->font, previous, code_point);
+        else
+            pen = glyph->origin;
+        if (glyph->rect.w) {
+            add_glyph_quad(layout, glyph, pen - glyph->origin);
+            if (pen - glyph->origin + glyph->rect.w > width)
+                width = pen - glyph->origin + glyph->rect.w;
+        }
+        pen += glyph->advance;
+        previous = code_point;
+    }
+
+    // Set geometry
+    layout->shadow_offset = 0;
+    if (info->shadow) {
+        layout->shadow_offset = h / SHADOW_OFFSET_DIVISOR;
+        if (layout->shadow_offset < MIN_SHADOW_OFFSET)
+            layout->shadow_offset = MIN_SHADOW_OFFSET;
+    }
+    rect->w = width + layout->shadow_offset;
+    rect->h = cache->height + layout->shadow_offset;
+    if (info->oversize_mode == OVERSIZE_SHRINK && text_height != NULL)
+        *text_height = h;
+
+    if (text_buffer != text)
+        free(text_buffer);
+    TRACE_END(layout_text);
+    return 0;
+}
+
+// A function to draw the quads of a layout in a single color
+static void draw_glyph_quads(TextLayout *layout, SDL_Color *color, int x, int y)
+{
+    int page = -1;
+    SDL_Rect dst;
+    for (int i = 0; i < layout->num_quads; i++) {
+        GlyphQuad *quad = layout->quads + i;
+        if (quad->page != page) {
+            page = quad->page;
+            SDL_SetTextureColorMod(atlas_pages[page].texture, color->r, color->g, color->b);
+            SDL_SetTextureAlphaMod(atlas_pages[page].texture, color->a);
+        }
+        dst = (SDL_Rect) {x + quad->dst.x, y + quad->dst.y, quad->dst.w, quad->dst.h};
+        SDL_RenderCopy(renderer, atlas_pages[page].texture, &quad->src, &dst);
+    }
+}
+
+// A function to draw laid out text, with its shadow if enabled
+void draw_text(TextLayout *layout, TextInfo *info, SDL_Rect *rect)
+{
+    if (info->shadow)
+        draw_glyph_quads(layout,
+            info->shadow_color,
+            rect->x + layout->shadow_offset,
+            rect->y + layout->shadow_offset
+        );
+    draw_glyph_quads(layout, info->color, rect->x, rect->y);
+}
+
+// A function to free the quads of a layout
+void free_text_layout(TextLayout *layout)
+{
+    free(layout->quads);
+    layout->quads = NULL;
+    layout->num_quads = 0;
+    layout->capacity = 0;
+}
+
+// A function to free the glyph caches and atlas
+void quit_text()
+{
+    GlyphCache *tmp;
+    for (GlyphCache *cache = glyph_caches; cache != NULL; cache = tmp) {
+        tmp = cache->next;
+        if (cache->owns_font)
+            TTF_CloseFont(cache->font);
+        free(cache->font_path);
+        free(cache->glyphs);
+        free(cache);
+    }
+    glyph_caches = NULL;
+    for (int i = 0; i < num_atlas_pages; i++)
+        SDL_DestroyTexture(atlas_pages[i].texture);
+    free(atlas_pages);
+    atlas_pages = NULL;
+    num_atlas_pages = 0;
+}
@@ -0,0 +1,48 @@
+#define GLYPH_ATLAS_SIZE 1024
+#define GLYPH_ATLAS_PADDING 1
+#define GLYPH_ATLAS_MAX_SHELVES 128
+#define GLYPH_TABLE_MIN_SIZE 128
+#define SHADOW_OFFSET_DIVISOR 40
+#define MIN_SHADOW_OFFSET 2
+
+// Glyph rasterized into the atlas
+typedef struct {
+    Uint16   code_point;
+    int      page;
+    SDL_Rect rect; // Location in the atlas page, w = 0 for blank glyphs
+    int      origin; // Distance between the left edge of the bitmap and the pen position
+    int      advance;
+} Glyph;
+
+// Row of equal height glyphs in an atlas page
+typedef struct {
+    int y;
+    int height;
+    int x;
+} Shelf;
+
+// Texture holding glyphs from all fonts
+typedef struct {
+    SDL_Texture *texture;
+    Shelf       shelves[GLYPH_ATLAS_MAX_SHELVES];
+    int         num_shelves;
+    int         next_y;
+} AtlasPage;
+
+// Linked list of glyph caches, one per font and size
+typedef struct glyph_cache {
+    char               *font_path;
+    int                font_size;
+    TTF_Font           *font;
+    bool               owns_font;
+    int                height;
+    Glyph              *glyphs; // Open addressing hash table keyed by code point
+    Uint32             capacity;
+    Uint32             num_glyphs;
+    struct glyph_cache *next;
+} GlyphCache;
+
+void quit_text(void);
+int layout_text(const char *text, TextInfo *info, TextLayout *layout, SDL_Rect *rect, int *text_height);
+void draw_text(TextLayout *layout, TextInfo *info, SDL_Rect *rect);
+void free_text_layout(TextLayout *layout);
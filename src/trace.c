@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "trace.h"
+#include "util.h"
+#include "worker.h"
+#include "debug.h"
+
+static double get_trace_time(Uint64 counter);
+static void write_trace_file(void *data);
+static void finish_trace_write(void *data);
+
+bool tracing = false;
+static Trace trace = {0};
+
+// A function to start recording spans to be written to a trace file
+// periodically and at exit
+void init_trace(const char *path)
+{
+    trace.events = calloc(TRACE_MAX_EVENTS, sizeof(TraceEvent));
+    if (trace.events == NULL) {
+        log_error("Could not allocate trace buffer");
+        return;
+    }
+    trace.path = strdup(path);
+    trace.frequency = SDL_GetPerformanceFrequency();
+    trace.start = SDL_GetPerformanceCounter();
+    trace.next_write = SDL_GetTicks() + TRACE_WRITE_INTERVAL;
+    SDL_AtomicSet(&trace.next_event, 0);
+    SDL_AtomicSet(&trace.num_threads, 0);
+    tracing = true;
+    set_trace_thread_name(MAIN_THREAD_NAME);
+}
+
+// A function to record a span which started at the given counter value and
+// ends now, overwriting the oldest span once the ring is full
+void add_trace_event(const char *name, Uint64 start)
+{
+    Uint64 end = SDL_GetPerformanceCounter();
+    Uint32 position = (Uint32) SDL_AtomicAdd(&trace.next_event, 1);
+    TraceEvent *event = trace.events + (position & (TRACE_MAX_EVENTS - 1));
+
+    // Mark the slot as being written so a concurrent file write skips it
+    SDL_AtomicSet(&event->sequence, 0);
+    SDL_MemoryBarrierRelease();
+    event->name = name;
+    event->start = start;
+    event->end = end;
+    event->thread_id = SDL_ThreadID();
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&event->sequence, (int) (position + 1));
+}
+
+// A function to label the calling thread in the trace
+void set_trace_thread_name(const char *name)
+{
+    if (!tracing)
+        return;
+    int i = SDL_AtomicAdd(&trace.num_threads, 1);
+    if (i >= TRACE_MAX_THREADS)
+        return;
+    trace.threads[i] = (TraceThread) {
+        .name = name,
+        .thread_id = SDL_ThreadID()
+    };
+}
+
+// A function to convert a performance counter value to microseconds since tracing started
+static double get_trace_time(Uint64 counter)
+{
+    return (double) (counter - trace.start) * 1000000.0 / (double) trace.frequency;
+}
+
+// A function to write the recorded spans in Chrome trace event format to a
+// temporary file and move it over the trace file. Spans may be recorded
+// while this runs, slots that change while they are read are skipped
+static void write_trace_file(void *data)
+{
+    UNUSED(data);
+    size_t length = strlen(trace.path) + sizeof(".tmp");
+    char *tmp_path = malloc(length);
+    snprintf(tmp_path, length, "%s.tmp", trace.path);
+    FILE *file = fopen(tmp_path, "w");
+    if (file == NULL) {
+        log_error("Could not open trace file '%s'", tmp_path);
+        free(tmp_path);
+        return;
+    }
+    fputs("{\"traceEvents\":[\n", file);
+    fprintf(file,
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":0,\"args\":{\"name\":\"%s\"}}",
+        TRACE_PROCESS_ID,
+        EXECUTABLE_TITLE
+    );
+    int num_threads = SDL_AtomicGet(&trace.num_threads);
+    if (num_threads > TRACE_MAX_THREADS)
+        num_threads = TRACE_MAX_THREADS;
+    for (int i = 0; i < num_threads; i++) {
+        fprintf(file,
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+            TRACE_PROCESS_ID,
+            (unsigned long) trace.threads[i].thread_id,
+            trace.threads[i].name
+        );
+    }
+
+    // Walk the ring from the oldest slot to the newest
+    Uint32 next = (Uint32) SDL_AtomicGet(&trace.next_event);
+    for (Uint32 i = 0; i < TRACE_MAX_EVENTS; i++) {
+        TraceEvent *slot = trace.events + ((next + i) & (TRACE_MAX_EVENTS - 1));
+        int sequence = SDL_AtomicGet(&slot->sequence);
+        if (!sequence)
+            continue;
+        SDL_MemoryBarrierAcquire();
+        TraceEvent event = {
+            .name = slot->name,
+            .start = slot->start,
+            .end = slot->end,
+            .thread_id = slot->thread_id
+        };
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&slot->sequence) != sequence)
+            continue;
+        double start = get_trace_time(event.start);
+        fprintf(file,
+            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%i,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+            event.name,
+            TRACE_PROCESS_ID,
+            (unsigned long) event.thread_id,
+            start,
+            get_trace_time(event.end) - start
+        );
+    }
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", file);
+    bool written = !ferror(file);
+    written = !fclose(file) && written;
+
+    // Windows can't rename over an existing file
+    if (written && rename(tmp_path, trace.path)) {
+        remove(trace.path);
+        written = !rename(tmp_path, trace.path);
+    }
+    if (!written) {
+        log_error("Could not write trace file '%s'", trace.path);
+        remove(tmp_path);
+    }
+    free(tmp_path);
+}
+
+// A function to allow the next periodic trace write
+static void finish_trace_write(void *data)
+{
+    UNUSED(data);
+    trace.writing = false;
+}
+
+// A function to write the trace file on a worker thread when the write
+// interval has passed, returns when the next write is due
+Uint32 update_trace(Uint32 now)
+{
+    if (SDL_TICKS_PASSED(now, trace.next_write) && !trace.writing) {
+        trace.next_write = now + TRACE_WRITE_INTERVAL;
+        trace.writing = true;
+        if (!submit_job(write_trace_file, finish_trace_write, NULL)) {
+            write_trace_file(NULL);
+            finish_trace_write(NULL);
+        }
+    }
+    return trace.next_write;
+}
+
+// A function to write the trace file a final time and stop tracing, must be
+// called after all other threads have stopped
+void quit_trace()
+{
+    if (!tracing)
+        return;
+    tracing = false;
+    write_trace_file(NULL);
+    free(trace.events);
+    free(trace.path);
+    trace.events = NULL;
+    trace.path = NULL;
+}
@@ -0,0 +1,47 @@
+#define TRACE_MAX_EVENTS 262144 // Must be a power of 2
+#define TRACE_WRITE_INTERVAL 30000
+#define TRACE_MAX_THREADS 16
+#define TRACE_PROCESS_ID 1
+#define MAIN_THREAD_NAME "Main Thread"
+
+// Completed span, recorded once when it ends
+typedef struct {
+    SDL_atomic_t sequence; // Position of the event plus 1, 0 while it is being written
+    const char   *name;
+    Uint64       start;
+    Uint64       end;
+    SDL_threadID thread_id;
+} TraceEvent;
+
+// Name of a thread shown in the trace viewer
+typedef struct {
+    const char   *name;
+    SDL_threadID thread_id;
+} TraceThread;
+
+// Preallocated ring of the most recent spans, slots are claimed with an
+// atomic add so any thread can record without locking. The ring is written
+// to the file periodically, so a trace survives the launcher being killed
+typedef struct {
+    char         *path;
+    TraceEvent   *events;
+    SDL_atomic_t next_event;
+    TraceThread  threads[TRACE_MAX_THREADS];
+    SDL_atomic_t num_threads;
+    Uint64       start; // Counter value when tracing started
+    Uint64       frequency;
+    Uint32       next_write;
+    bool         writing; // A worker is writing the file
+} Trace;
+
+extern bool tracing;
+
+// Span macros, the name must be an identifier and is used as the event name
+#define TRACE_BEGIN(name) Uint64 trace_start_##name = tracing ? SDL_GetPerformanceCounter() : 0
+#define TRACE_END(name) do { if (tracing) add_trace_event(#name, trace_start_##name); } while (0)
+
+void init_trace(const char *path);
+void add_trace_event(const char *name, Uint64 start);
+void set_trace_thread_name(const char *name);
+Uint32 update_trace(Uint32 now);
+void quit_trace(void);
@@ -3,24 +3,27 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdbool.h>
-#include <time.h>
 #include <getopt.h>
 #include <SDL.h>
 #include <SDL_syswm.h>
 #include "launcher.h"
 #include <launcher_config.h>
 #include "util.h"
+#include "arena.h"
 #include "debug.h"
+#include "trace.h"
 #include "platform/platform.h"
 #include "external/ini.h"
 
 static void add_gamepad_control(const char *label, const char *cmd);
 static bool parse_mode_setting(ModeSettingType type, const char *value, int *setting);
 static Menu *create_menu(const char *menu_name, size_t *num_menus);
+static char *intern_path(const char *path);
 
 extern Config          config;
 extern GamepadControl  *gamepad_controls;
 extern Hotkey          *hotkeys;
+extern Arena           config_arena;
 Menu                   *menu  = NULL;
 Entry                  *entry = NULL;
 
@@ -41,12 +44,13 @@ void handle_arguments(int argc, char *argv[], char **config_file_path)
         bool version = false;
         bool help = false;
         int rc;
-        const char *short_opts = "hvc:d";
+        const char *short_opts = "hvc:dt:";
         static const struct option long_opts[] = {
             { "help",         no_argument,       NULL, 'h' },
             { "version",      no_argument,       NULL, 'v' },
             { "config",       required_argument, NULL, 'c' },
             { "debug",        no_argument,       NULL, 'd' },
+            { "trace",        required_argument, NULL, 't' },
             { 0, 0, 0, 0 }
         };
     
@@ -70,6 +74,10 @@ void handle_arguments(int argc, char *argv[], char **config_file_path)
                 case 'd':
                     config.debug = true;
                     break;
+
+                case 't':
+                    init_trace(optarg);
+                    break;
             }
         }
 
@@ -117,7 +125,9 @@ void parse_config_file(const char *config_file_path)
     FILE *file = fopen(config_file_path, "r");
     if (file == NULL)
         log_fatal("Could not open config file");
+    TRACE_BEGIN(parse_config_file);
     int error = ini_parse_file(file, config_handler, NULL);
+    TRACE_END(parse_config_file);
     fclose(file);
     
     if (error < 0)
@@ -131,7 +141,7 @@ int config_handler(void *user, const char *section, const char *name, const char
 
     if (MATCH(section, "General")) {
         if (MATCH(name, SETTING_DEFAULT_MENU))
-            config.default_menu = strdup(value);
+            config.default_menu = intern_string(&config_arena, value);
         else if (MATCH(name, SETTING_VSYNC))
             convert_bool(value, &config.vsync);
         else if(MATCH(name, SETTING_FPS_LIMIT)) {
@@ -146,10 +156,17 @@ int config_handler(void *user, const char *section, const char *name, const char
                 config.application_timeout = 1000 * application_timeout;
             }
         }
+        else if (MATCH(name, SETTING_TEXTURE_MEMORY_LIMIT)) {
+            int texture_memory_limit = atoi(value);
+            if (texture_memory_limit >= 0)
+                config.texture_memory_limit = (size_t) texture_memory_limit * BYTES_PER_MEGABYTE;
+        }
         else if (MATCH(name, SETTING_ON_LAUNCH))
             parse_mode_setting(MODE_SETTING_ON_LAUNCH, value, (int*) &config.on_launch);
         else if (MATCH(name, SETTING_WRAP_ENTRIES))
             convert_bool(value, &config.wrap_entries);
+        else if (MATCH(name, SETTING_ANIMATED_NAVIGATION))
+            convert_bool(value, &config.animated_navigation);
         else if (MATCH(name, SETTING_RESET_ON_BACK))
             convert_bool(value, &config.reset_on_back);
         else if (MATCH(name, SETTING_MOUSE_SELECT))
@@ -157,9 +174,13 @@ int config_handler(void *user, const char *section, const char *name, const char
         else if (MATCH(name, SETTING_INHIBIT_OS_SCREENSAVER))
             convert_bool(value, &config.inhibit_os_screensaver);
         else if (MATCH(name, SETTING_STARTUP_CMD))
-            config.startup_cmd = strdup(value);
+            config.startup_cmd = intern_string(&config_arena, value);
         else if (MATCH(name, SETTING_QUIT_CMD))
-            config.quit_cmd = strdup(value);
+            config.quit_cmd = intern_string(&config_arena, value);
+        else if (MATCH(name, SETTING_CONTROL_SOCKET))
+            config.control_socket = intern_path(value);
+        else if (MATCH(name, SETTING_METRICS_FILE))
+            config.metrics_file = intern_path(value);
     }
 
     else if (MATCH(section, "Layout")) {
@@ -186,6 +207,11 @@ int config_handler(void *user, const char *section, const char *name, const char
             if (is_percent(value))
                 copy_string(config.vcenter, value, sizeof(config.vcenter));
         }
+        else if (MATCH(name, SETTING_ROWS)) {
+            int rows = atoi(value);
+            if (rows > 0)
+                config.rows = (unsigned int) rows;
+        }
     }
 
     else if (MATCH(section, "Background")) {
@@ -193,14 +219,10 @@ int config_handler(void *user, const char *section, const char *name, const char
             parse_mode_setting(MODE_SETTING_BACKGROUND, value, (int*) &config.background_mode);
         else if (MATCH(name, SETTING_BACKGROUND_COLOR))
             hex_to_color(value, &config.background_color);
-        else if (MATCH(name, SETTING_BACKGROUND_IMAGE)) {
-            config.background_image = strdup(value);
-            clean_path(config.background_image);
-        }
-        else if (MATCH(name, SETTING_SLIDESHOW_DIRECTORY)) {
-            config.slideshow_directory = strdup(value);
-            clean_path(config.slideshow_directory);
-        }
+        else if (MATCH(name, SETTING_BACKGROUND_IMAGE))
+            config.background_image = intern_path(value);
+        else if (MATCH(name, SETTING_SLIDESHOW_DIRECTORY))
+            config.slideshow_directory = intern_path(value);
         else if (MATCH(name, SETTING_SLIDESHOW_IMAGE_DURATION)) {
             Uint32 slideshow_image_duration = ((Uint32) atoi(value))*1000;
             if (slideshow_image_duration >= MIN_SLIDESHOW_IMAGE_DURATION && 
@@ -227,10 +249,8 @@ int config_handler(void *user, const char *section, const char *name, const char
     else if (MATCH(section, "Titles")) {
         if (MATCH(name, SETTING_TITLES_ENABLED))
             convert_bool(value, &config.titles_enabled);
-        else if (MATCH(name, SETTING_TITLE_FONT)) {
-            config.title_font_path = strdup(value);
-            clean_path(config.title_font_path);
-        }
+        else if (MATCH(name, SETTING_TITLE_FONT))
+            config.title_font_path = intern_path(value);
         else if (MATCH(name, SETTING_TITLE_FONT_SIZE))
             config.title_font_size = (unsigned int) atoi(value);
         else if (MATCH(name, SETTING_TITLE_FONT_COLOR))
@@ -314,10 +334,8 @@ int config_handler(void *user, const char *section, const char *name, const char
             convert_bool(value, &config.clock_show_date);
         else if (MATCH(name, SETTING_CLOCK_ALIGNMENT))
             parse_mode_setting(MODE_SETTING_ALIGNMENT, value, (int*) &config.clock_alignment);
-        else if (MATCH(name, SETTING_CLOCK_FONT)) {
-            config.clock_font_path = strdup(value);
-            clean_path(config.clock_font_path);
-        }
+        else if (MATCH(name, SETTING_CLOCK_FONT))
+            config.clock_font_path = intern_path(value);
         else if (MATCH(name, SETTING_CLOCK_MARGIN)) {
             if (is_percent(value))
                 copy_string(config.clock_margin_str, value, sizeof(config.clock_margin_str));
@@ -381,10 +399,8 @@ int config_handler(void *user, const char *section, const char *name, const char
             convert_bool(value, &config.gamepad_enabled);
         else if (MATCH(name, SETTING_GAMEPAD_DEVICE))
             config.gamepad_device = atoi(value);
-        else if (MATCH(name, SETTING_GAMEPAD_MAPPINGS_FILE)) {
-            config.gamepad_mappings_file = strdup(value);
-            clean_path(config.gamepad_mappings_file);
-        }
+        else if (MATCH(name, SETTING_GAMEPAD_MAPPINGS_FILE))
+            config.gamepad_mappings_file = intern_path(value);
 
         // Parse gamepad controls
         else
@@ -393,8 +409,6 @@ int config_handler(void *user, const char *section, const char *name, const char
 
     // Parse menus/entries
     else {
-        Entry *previous_entry = NULL;
-
         // Check if menu struct exists for current section
         if (config.first_menu == NULL) {
             config.first_menu = create_menu(section, &config.num_menus);
@@ -418,66 +432,43 @@ int config_handler(void *user, const char *section, const char *name, const char
         }
 
         // Parse entry line for title, icon path, command
-        char *string = (char*) value;
-        char *token;
+        char *tokens[3];
         char *delimiter = ";";
-        token = strtok(string, delimiter);
-        if (token != NULL) {
-
-            // Create first entry in the menu if none exists
-            if (menu->first_entry == NULL) {
-                menu->first_entry = malloc(sizeof(Entry));
-                entry = menu->first_entry;
-                entry->next = NULL;
-            }
-
-            // Add entry to the end of the linked list
-            else {
-                previous_entry = entry;
-                entry = entry->next;
-                entry = malloc(sizeof(Entry));
-                previous_entry->next = entry;
-                entry->next = NULL;
-            }
-            entry->title_offset = 0;
-        }
-
-        // Store data in entry struct
+        char *token = strtok((char*) value, delimiter);
         int i;
-        for (i = 0;i < 3 && token != NULL; i++) {
-            if (i == 0)
-                entry->title = strdup(token);
-            else if (i == 1) {
-                entry->icon_path = strdup(token);
-                clean_path(entry->icon_path);
-                delimiter = "";
-            }
-            else if (i == 2)
-                entry->cmd = strdup(token);
+        for (i = 0; i < 3 && token != NULL; i++) {
+            tokens[i] = token;
 
+            // The command is the remainder of the line
+            if (i == 1)
+                delimiter = "";
             token = strtok(NULL, delimiter);
         }
 
-        // Delete entry if parse failed to find 3 valid tokens
-        if (i != 3 || MATCH(":select", entry->cmd)) {
-            if (menu->num_entries == 0) {
-                free(menu->first_entry);
-                menu->first_entry = NULL;
-            }
-            else {
-                free(entry);
-                entry = previous_entry;
-                entry->next = NULL;
-            }
-        }
+        // Skip entry if parse failed to find 3 valid tokens
+        if (i != 3 || MATCH(SCMD_SELECT, tokens[2]))
+            return 0;
+
+        // Add entry to the end of the linked list
+        Entry *new_entry = arena_alloc(&config_arena, sizeof(Entry));
+        *new_entry = (Entry) {
+            .title = intern_string(&config_arena, tokens[0]),
+            .icon_path = intern_path(tokens[1]),
+            .cmd = intern_string(&config_arena, tokens[2]),
+            .title_offset = 0,
+            .title_layout = {0},
+            .next = NULL,
+            .previous = NULL
+        };
+        new_entry->icon_selected_path = selected_path(new_entry->icon_path);
+        if (menu->first_entry == NULL)
+            menu->first_entry = new_entry;
         else {
-            if (menu->num_entries == 0)
-                entry->previous = NULL;
-            else
-                entry->previous = previous_entry;
-            menu->num_entries++;
-            entry->icon_selected_path = selected_path(entry->icon_path);
+            entry->next = new_entry;
+            new_entry->previous = entry;
         }
+        entry = new_entry;
+        menu->num_entries++;
     }
     return 0;
 }
@@ -521,6 +512,13 @@ void clean_path(char *path)
     }    
 }
 
+// A function to intern a path after removing enclosing quotation marks
+static char *intern_path(const char *path)
+{
+    clean_path((char*) path);
+    return intern_string(&config_arena, path);
+}
+
 // A function to get the selected path 
 char *selected_path(const char *path)
 {
@@ -544,7 +542,7 @@ char *selected_path(const char *path)
     strcat(buffer, p);
 
     if (file_exists(buffer))
-        out = strdup(buffer);
+        out = intern_string(&config_arena, buffer);
     return out;
 }
 
@@ -743,24 +741,6 @@ Uint16 get_unicode_code_point(const char *p, int *bytes)
     return result;
 }
 
-// A function to generate an array of random indices
-void random_array(int *array, int array_size)
-{
-    // Fill array with initial indices
-    for (int i = 0; i < array_size; i++)
-        array[i] = i;
-
-    // Shuffle array indices randomly, see https://en.wikipedia.org/wiki/Fisher%E2%80%93Yates_shuffle
-    srand((unsigned int) time(NULL));
-    int tmp;
-    for (int i = 0; i < array_size - 1; i++) {
-        int j = (rand() % (array_size - i)) + i;
-        tmp = array[i];
-        array[i] = array[j];
-        array[j] = tmp;
-    }
-}
-
 // A function to calculate the total width of all screen objects
 unsigned int calculate_width(int buttons, int icon_spacing, int icon_size, int highlight_hpadding)
 {
@@ -788,15 +768,15 @@ void add_hotkey(const char *keycode, const char *cmd)
 
     // Create first node if not initialized, else add to end of linked list
     if (current_hotkey == NULL) {
-        hotkeys = malloc(sizeof(Hotkey));
+        hotkeys = arena_alloc(&config_arena, sizeof(Hotkey));
         current_hotkey = hotkeys;
     }
     else {
-        current_hotkey->next = malloc(sizeof(Hotkey));
+        current_hotkey->next = arena_alloc(&config_arena, sizeof(Hotkey));
         current_hotkey = current_hotkey->next;
     }
     current_hotkey->keycode = code;
-    current_hotkey->cmd = strdup(cmd);
+    current_hotkey->cmd = intern_string(&config_arena, cmd);
     current_hotkey->next = NULL;
 }
 
@@ -847,13 +827,13 @@ static void add_gamepad_control(const char *label, const char *cmd)
     // Begin the linked list if none exists
     static GamepadControl *current_gamepad_control = NULL;
     if (current_gamepad_control == NULL) {
-        gamepad_controls = malloc(sizeof(GamepadControl));
+        gamepad_controls = arena_alloc(&config_arena, sizeof(GamepadControl));
         current_gamepad_control = gamepad_controls;
     }
 
     // Add another node to the linked list
     else {
-        current_gamepad_control->next = malloc(sizeof(GamepadControl));
+        current_gamepad_control->next = arena_alloc(&config_arena, sizeof(GamepadControl));
         current_gamepad_control = current_gamepad_control->next;
     }
 
@@ -865,7 +845,7 @@ static void add_gamepad_control(const char *label, const char *cmd)
         .repeat   = 0,
         .next     = NULL
     };
-    current_gamepad_control->cmd = strdup(cmd);
+    current_gamepad_control->cmd = intern_string(&config_arena, cmd);
 }
 
 // A function to convert a string percent setting to an int value
@@ -1024,7 +1004,32 @@ void validate_settings(Geometry *geo)
         vcenter = lower_limit;
     else if (vcenter > upper_limit)
         vcenter = upper_limit;
-    geo->y_margin = vcenter - button_height / 2;
+
+    // Reduce number of rows if they can't all fit on screen, rows are kept
+    // far enough apart for the highlight not to overlap the next row
+    int row_spacing = MAX(config.icon_spacing, 2*config.highlight_vpadding);
+    int max_height = geo->screen_height - 2*geo->screen_margin;
+    if (config.rows > 1 && (int) config.rows*(button_height + row_spacing) - row_spacing > max_height) {
+        unsigned int i;
+        for (i = config.rows; i > 1 && (int) i*(button_height + row_spacing) - row_spacing > max_height; i--);
+        log_error(
+            "Not enough screen space for %i rows, reducing to %i",
+            config.rows,
+            i
+        );
+        config.rows = i;
+    }
+
+    // Center the rows on the centerline, keeping a grid on screen
+    int grid_height = (int) config.rows*(button_height + row_spacing) - row_spacing;
+    geo->y_advance = button_height + row_spacing;
+    geo->y_margin = vcenter - grid_height / 2;
+    if (config.rows > 1) {
+        if (geo->y_margin + grid_height > geo->screen_height - geo->screen_margin)
+            geo->y_margin = geo->screen_height - geo->screen_margin - grid_height;
+        if (geo->y_margin < geo->screen_margin)
+            geo->y_margin = geo->screen_margin;
+    }
 
     // Max highlight outline
     int max_highlight_outline_size = (config.highlight_hpadding < config.highlight_vpadding) 
@@ -1056,7 +1061,7 @@ Menu *get_menu(const char *menu_name)
 // A function to allocate memory to and initialize a menu struct
 Menu *create_menu(const char *menu_name, size_t *num_menus)
 {
-    Menu *menu = malloc(sizeof(Menu));
+    Menu *menu = arena_alloc(&config_arena, sizeof(Menu));
     *menu = (Menu) {
         .first_entry = NULL,
         .next = NULL,
@@ -1067,7 +1072,7 @@ Menu *create_menu(const char *menu_name, size_t *num_menus)
         .highlight_position = 0,
         .rendered = false
     };
-    menu->name = strdup(menu_name);
+    menu->name = intern_string(&config_arena, menu_name);
     (*num_menus)++;
     
     return menu;
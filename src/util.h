@@ -1,4 +1,3 @@
-#define MAX_LOG_LINE_BYTES 501
 #define MAX_PATH_CHARS 1001 //250 wide characters
 #define INVALID_PERCENT_VALUE -1
 
@@ -15,6 +14,7 @@
 
 #define DIV_ROUND_UP(a, b) ((a + (b - 1)) / b)
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
 struct gamepad_info {
     const char *label;
@@ -38,7 +38,6 @@ void copy_string(char* dest, const char* string, size_t size);
 void utf8_truncate(char *string, int width, int max_width);
 void convert_percent_to_int(char *string, int *result, int max_value);
 void add_hotkey(const char *keycode, const char *cmd);
-void random_array(int *array, int array_size);
 void clean_path(char *path);
 void validate_settings(Geometry *geo);
 void parse_config_file(const char *config_file_path);
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+#include "launcher.h"
+#include <launcher_config.h>
+#include "worker.h"
+#include "debug.h"
+#include "trace.h"
+
+static int worker_thread(void *data);
+static Job *get_next_job(void);
+static void push_completed_job(Job *job);
+
+static WorkerPool pool = {0};
+
+// A function to start the worker threads
+int init_workers()
+{
+    pool.mutex = SDL_CreateMutex();
+    pool.cond = SDL_CreateCond();
+    pool.event_type = SDL_RegisterEvents(1);
+    if (pool.mutex == NULL || pool.cond == NULL) {
+        log_error("Could not create worker pool\n%s", SDL_GetError());
+        return 1;
+    }
+
+    // Leave one core for the main thread
+    int num_threads = SDL_GetCPUCount() - 1;
+    if (num_threads < 1)
+        num_threads = 1;
+    else if (num_threads > MAX_WORKERS)
+        num_threads = MAX_WORKERS;
+    for (int i = 0; i < num_threads; i++) {
+        pool.threads[pool.num_threads] = SDL_CreateThread(worker_thread, WORKER_THREAD_NAME, NULL);
+        if (pool.threads[pool.num_threads] == NULL)
+            log_error("Could not create worker thread\n%s", SDL_GetError());
+        else
+            pool.num_threads++;
+    }
+    if (!pool.num_threads)
+        return 1;
+    log_debug("Started %i worker threads", pool.num_threads);
+    return 0;
+}
+
+// A function to stop the worker threads and discard unfinished jobs
+void quit_workers()
+{
+    if (pool.mutex == NULL)
+        return;
+    SDL_LockMutex(pool.mutex);
+    pool.quit = true;
+    SDL_CondBroadcast(pool.cond);
+    SDL_UnlockMutex(pool.mutex);
+    for (int i = 0; i < pool.num_threads; i++)
+        SDL_WaitThread(pool.threads[i], NULL);
+    pool.num_threads = 0;
+
+    // Free jobs that never ran or were never completed
+    Job *tmp;
+    for (Job *job = pool.first_job; job != NULL; job = tmp) {
+        tmp = job->next;
+        free(job);
+    }
+    for (Job *job = SDL_AtomicSetPtr(&pool.completed, NULL); job != NULL; job = tmp) {
+        tmp = job->next;
+        free(job);
+    }
+    pool.first_job = NULL;
+    pool.last_job = NULL;
+    SDL_DestroyCond(pool.cond);
+    SDL_DestroyMutex(pool.mutex);
+    pool.cond = NULL;
+    pool.mutex = NULL;
+}
+
+// A function to queue a job, run() is called on a worker thread and
+// complete() later on the main thread from process_completed_jobs()
+bool submit_job(JobFunction run, JobFunction complete, void *data)
+{
+    if (!pool.num_threads)
+        return false;
+    Job *job = malloc(sizeof(Job));
+    *job = (Job) {
+        .run = run,
+        .complete = complete,
+        .data = data,
+        .next = NULL
+    };
+    SDL_LockMutex(pool.mutex);
+    if (pool.last_job == NULL)
+        pool.first_job = job;
+    else
+        pool.last_job->next = job;
+    pool.last_job = job;
+    SDL_CondSignal(pool.cond);
+    SDL_UnlockMutex(pool.mutex);
+    return true;
+}
+
+// A function to wait for the next queued job, returns NULL when quitting
+static Job *get_next_job()
+{
+    SDL_LockMutex(pool.mutex);
+    while (pool.first_job == NULL && !pool.quit)
+        SDL_CondWait(pool.cond, pool.mutex);
+    Job *job = NULL;
+    if (!pool.quit) {
+        job = pool.first_job;
+        pool.first_job = job->next;
+        if (pool.first_job == NULL)
+            pool.last_job = NULL;
+    }
+    SDL_UnlockMutex(pool.mutex);
+    return job;
+}
+
+// A function to hand a finished job back to the main thread
+static void push_completed_job(Job *job)
+{
+    void *head;
+    do {
+        head = SDL_AtomicGetPtr(&pool.completed);
+        job->next = (Job*) head;
+    } while (!SDL_AtomicCASPtr(&pool.completed, head, job));
+
+    // Wake the main loop if it is waiting for events, once per batch
+    if (head == NULL) {
+        SDL_Event event = {0};
+        event.type = pool.event_type;
+        SDL_PushEvent(&event);
+    }
+}
+
+// A function run by each worker thread
+static int worker_thread(void *data)
+{
+    Job *job;
+    set_trace_thread_name(WORKER_THREAD_NAME);
+    while ((job = get_next_job()) != NULL) {
+        job->run(job->data);
+        push_completed_job(job);
+    }
+    return 0;
+}
+
+// A function to run the completion callbacks of finished jobs on the main thread
+void process_completed_jobs()
+{
+    // Take the whole stack at once and reverse it into completion order
+    Job *job = SDL_AtomicSetPtr(&pool.completed, NULL);
+    Job *ordered = NULL;
+    Job *tmp;
+    while (job != NULL) {
+        tmp = job->next;
+        job->next = ordered;
+        ordered = job;
+        job = tmp;
+    }
+    for (job = ordered; job != NULL; job = tmp) {
+        tmp = job->next;
+        if (job->complete != NULL)
+            job->complete(job->data);
+        free(job);
+    }
+}
+
@@ -0,0 +1,30 @@
+#define MAX_WORKERS 4
+#define WORKER_THREAD_NAME "Worker Thread"
+
+typedef void (*JobFunction)(void *data);
+
+// Unit of work run on a worker thread, then completed on the main thread
+typedef struct job {
+    JobFunction run;
+    JobFunction complete;
+    void        *data;
+    struct job  *next;
+} Job;
+
+// Fixed set of worker threads sharing one job queue
+typedef struct {
+    SDL_Thread   *threads[MAX_WORKERS];
+    int          num_threads;
+    SDL_mutex    *mutex; // Guards the job queue and quit flag
+    SDL_cond     *cond;
+    Job          *first_job;
+    Job          *last_job;
+    bool         quit;
+    void         *completed; // Lock-free stack of finished jobs, pushed by workers, popped by the main thread
+    Uint32       event_type;
+} WorkerPool;
+
+int init_workers(void);
+void quit_workers(void);
+bool submit_job(JobFunction run, JobFunction complete, void *data);
+void process_completed_jobs(void);